@@ -0,0 +1,206 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_BLOCK_INDEX_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_BLOCK_INDEX_HPP
+
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+template< typename T, std::size_t N >
+class Block;
+
+template< typename T >
+class Node;
+
+template< typename T, std::size_t N >
+class BlockIndex
+{
+  private:
+	using value_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+
+	template< typename, std::size_t >
+	friend class ConstIterator;
+
+	template< typename, std::size_t >
+	friend class Iterator;
+
+	template< typename, typename, std::size_t, std::size_t >
+	friend class BucketStorage;
+
+	template< typename, typename, std::size_t >
+	friend class BlockTable;
+
+	size_type* sums;
+	Block< value_type, N >** ordered;
+	size_type count;
+	Block< value_type, N >* sentinel;
+	size_type total;
+
+	explicit BlockIndex(Block< value_type, N >* end_block) :
+		sums(nullptr), ordered(nullptr), count(0), sentinel(end_block), total(0)
+	{
+	}
+
+	size_type prefix(size_type ordinal) const
+	{
+		size_type sum = 0;
+		for (size_type i = ordinal; i > 0; i -= i & (~i + 1))
+		{
+			sum += sums[i - 1];
+		}
+		return sum;
+	}
+
+	size_type rank(const Block< value_type, N >* block, const Node< value_type >* node) const
+	{
+		return node ? prefix(block->ordinal) + block->rank_of(node) : total;
+	}
+
+	Block< value_type, N >* find(size_type& rank) const
+	{
+		size_type position = 0;
+		for (size_type step = std::bit_floor(count); step != 0; step >>= 1)
+		{
+			if (position + step <= count && sums[position + step - 1] <= rank)
+			{
+				position += step;
+				rank -= sums[position - 1];
+			}
+		}
+		return ordered[position];
+	}
+};
+
+template< typename T, typename Allocator, std::size_t N >
+class BlockTable : public BlockIndex< T, N >
+{
+  private:
+	using value_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using size_allocator = typename std::allocator_traits< Allocator >::template rebind_alloc< size_type >;
+	using block_allocator =
+		typename std::allocator_traits< Allocator >::template rebind_alloc< Block< value_type, N >* >;
+
+	template< typename, typename, std::size_t, std::size_t >
+	friend class BucketStorage;
+
+	std::vector< size_type, size_allocator > tree;
+	std::vector< Block< value_type, N >*, block_allocator > blocks;
+	std::vector< Block< value_type, N >*, block_allocator > by_id;
+	size_type vacant;
+
+	BlockTable(Block< value_type, N >* end_block, const Allocator& allocator) :
+		BlockIndex< value_type, N >(end_block), tree(allocator), blocks(allocator), by_id(allocator), vacant(0)
+	{
+	}
+
+	void sync() noexcept
+	{
+		this->sums = tree.data();
+		this->ordered = blocks.data();
+		this->count = tree.size();
+	}
+
+	void clear()
+	{
+		tree.clear();
+		blocks.clear();
+		by_id.clear();
+		this->total = 0;
+		vacant = 0;
+		sync();
+	}
+
+	void push_back(Block< value_type, N >* block)
+	{
+		if (by_id.size() < block->block_id)
+		{
+			by_id.resize(block->block_id, nullptr);
+		}
+		by_id[block->block_id - 1] = block;
+		size_type position = tree.size() + 1;
+		size_type sum = block->block_size;
+		for (size_type i = position - 1; i > position - (position & (~position + 1)); i -= i & (~i + 1))
+		{
+			sum += tree[i - 1];
+		}
+		tree.push_back(sum);
+		try
+		{
+			blocks.push_back(block);
+		} catch (...)
+		{
+			tree.pop_back();
+			throw;
+		}
+		block->ordinal = blocks.size() - 1;
+		this->total += block->block_size;
+		sync();
+	}
+
+	void erase(Block< value_type, N >* block)
+	{
+		add(block, -static_cast< difference_type >(block->block_size));
+		blocks[block->ordinal] = nullptr;
+		by_id[block->block_id - 1] = nullptr;
+		vacant++;
+		while (!blocks.empty() && blocks.back() == nullptr)
+		{
+			blocks.pop_back();
+			tree.pop_back();
+			vacant--;
+		}
+		if (vacant * 2 > blocks.size())
+		{
+			rebuild();
+		}
+		sync();
+	}
+
+	Block< value_type, N >* find_id(size_type id) const
+	{
+		return id != 0 && id <= by_id.size() ? by_id[id - 1] : nullptr;
+	}
+
+	void add(const Block< value_type, N >* block, difference_type delta)
+	{
+		for (size_type i = block->ordinal + 1; i <= tree.size(); i += i & (~i + 1))
+		{
+			tree[i - 1] += delta;
+		}
+		this->total += delta;
+	}
+
+	void rebuild()
+	{
+		size_type count = 0;
+		for (Block< value_type, N >* block : blocks)
+		{
+			if (block)
+			{
+				block->ordinal = count;
+				blocks[count++] = block;
+			}
+		}
+		blocks.resize(count);
+		tree.resize(count);
+		for (size_type i = 0; i < count; i++)
+		{
+			tree[i] = blocks[i]->block_size;
+		}
+		for (size_type i = 1; i <= count; i++)
+		{
+			size_type parent = i + (i & (~i + 1));
+			if (parent <= count)
+			{
+				tree[parent - 1] += tree[i - 1];
+			}
+		}
+		vacant = 0;
+	}
+};
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_BLOCK_INDEX_HPP
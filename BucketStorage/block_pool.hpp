@@ -0,0 +1,171 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_BLOCK_POOL_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_BLOCK_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <new>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#define CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP 1
+#endif
+
+class MappedBlockPool : public std::pmr::memory_resource
+{
+  public:
+	using size_type = std::size_t;
+
+	static constexpr size_type huge_page_size = size_type(2) << 20;
+
+	explicit MappedBlockPool(size_type reserve_bytes,
+							 bool huge_pages = true,
+							 std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+	MappedBlockPool(const MappedBlockPool& other) = delete;
+	MappedBlockPool& operator=(const MappedBlockPool& other) = delete;
+	~MappedBlockPool() override;
+
+	[[nodiscard]] size_type reserved() const noexcept { return end - base; }
+	[[nodiscard]] size_type used() const noexcept { return top - base; }
+	[[nodiscard]] size_type pooled() const noexcept { return free_bytes; }
+
+	void trim() noexcept;
+
+  private:
+	static constexpr size_type granule = alignof(std::max_align_t);
+
+	std::pmr::memory_resource* upstream;
+	unsigned char* mapping;
+	size_type mapping_size;
+	unsigned char* base;
+	unsigned char* top;
+	unsigned char* end;
+	std::map< size_type, void* > free_lists;
+	size_type free_bytes;
+
+	bool owns(const void* p) const noexcept { return p >= base && p < end; }
+
+	static void*& link(void* p) noexcept { return *static_cast< void** >(p); }
+
+	void* do_allocate(size_type bytes, size_type alignment) override;
+	void do_deallocate(void* p, size_type bytes, size_type alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+inline MappedBlockPool::MappedBlockPool(size_type reserve_bytes, bool huge_pages, std::pmr::memory_resource* upstream) :
+	upstream(upstream), mapping(nullptr), mapping_size(0), base(nullptr), top(nullptr), end(nullptr), free_bytes(0)
+{
+#ifdef CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP
+	size_type alignment = huge_pages ? huge_page_size : static_cast< size_type >(sysconf(_SC_PAGESIZE));
+	reserve_bytes = (reserve_bytes + alignment - 1) / alignment * alignment;
+	mapping_size = reserve_bytes + alignment;
+	void* address =
+		mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (address == MAP_FAILED)
+	{
+		throw std::bad_alloc();
+	}
+	mapping = static_cast< unsigned char* >(address);
+	base = mapping + (alignment - reinterpret_cast< std::uintptr_t >(mapping) % alignment) % alignment;
+	top = base;
+	end = base + reserve_bytes;
+#ifdef MADV_HUGEPAGE
+	if (huge_pages)
+	{
+		madvise(base, reserve_bytes, MADV_HUGEPAGE);
+	}
+#endif
+#else
+	(void)reserve_bytes;
+	(void)huge_pages;
+#endif
+}
+
+inline MappedBlockPool::~MappedBlockPool()
+{
+#ifdef CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP
+	if (mapping)
+	{
+		munmap(mapping, mapping_size);
+	}
+#endif
+}
+
+inline void* MappedBlockPool::do_allocate(size_type bytes, size_type alignment)
+{
+	size_type size = (bytes + granule - 1) / granule * granule;
+	auto list = free_lists.find(size);
+	if (list != free_lists.end() && list->second &&
+		reinterpret_cast< std::uintptr_t >(list->second) % alignment == 0)
+	{
+		void* result = list->second;
+		list->second = link(result);
+		free_bytes -= size;
+		return result;
+	}
+
+	if (base)
+	{
+		std::uintptr_t address = reinterpret_cast< std::uintptr_t >(top);
+		size_type padding = (alignment - address % alignment) % alignment;
+		if (size + padding <= static_cast< size_type >(end - top))
+		{
+			free_lists.try_emplace(size, nullptr);
+			top += padding + size;
+			return top - size;
+		}
+	}
+	return upstream->allocate(bytes, alignment);
+}
+
+inline void MappedBlockPool::do_deallocate(void* p, size_type bytes, size_type alignment)
+{
+	if (!owns(p))
+	{
+		upstream->deallocate(p, bytes, alignment);
+		return;
+	}
+
+	size_type size = (bytes + granule - 1) / granule * granule;
+	if (static_cast< unsigned char* >(p) + size == top)
+	{
+		top = static_cast< unsigned char* >(p);
+		return;
+	}
+	auto list = free_lists.find(size);
+	if (list == free_lists.end())
+	{
+		return;
+	}
+	link(p) = list->second;
+	list->second = p;
+	free_bytes += size;
+}
+
+inline void MappedBlockPool::trim() noexcept
+{
+#ifdef CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP
+	auto page = static_cast< std::uintptr_t >(sysconf(_SC_PAGESIZE));
+	for (auto& [size, list] : free_lists)
+	{
+		for (void* p = list; p; p = link(p))
+		{
+			std::uintptr_t first = (reinterpret_cast< std::uintptr_t >(p) + sizeof(void*) + page - 1) / page * page;
+			std::uintptr_t last = (reinterpret_cast< std::uintptr_t >(p) + size) / page * page;
+			if (first < last)
+			{
+				madvise(reinterpret_cast< void* >(first), last - first, MADV_DONTNEED);
+			}
+		}
+	}
+	std::uintptr_t tail = (reinterpret_cast< std::uintptr_t >(top) + page - 1) / page * page;
+	if (tail < reinterpret_cast< std::uintptr_t >(end))
+	{
+		madvise(reinterpret_cast< void* >(tail), reinterpret_cast< std::uintptr_t >(end) - tail, MADV_DONTNEED);
+	}
+#endif
+}
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_BLOCK_POOL_HPP
@@ -0,0 +1,68 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_CODEC_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_CODEC_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+template< typename T >
+struct BucketCodec
+{
+	static_assert(std::is_trivially_copyable_v< T >, "BucketCodec has to be specialized for this element type");
+
+	static void encode(std::ostream& out, const T& value)
+	{
+		out.write(reinterpret_cast< const char* >(&value), sizeof(T));
+	}
+
+	static T decode(std::istream& in)
+	{
+		T value;
+		if (!in.read(reinterpret_cast< char* >(&value), sizeof(T)))
+		{
+			throw std::runtime_error("BucketCodec: truncated stream");
+		}
+		return value;
+	}
+};
+
+template< typename C, typename Traits, typename A >
+struct BucketCodec< std::basic_string< C, Traits, A > >
+{
+	using string_type = std::basic_string< C, Traits, A >;
+
+	static void encode(std::ostream& out, const string_type& value)
+	{
+		auto length = static_cast< std::uint64_t >(value.size());
+		out.write(reinterpret_cast< const char* >(&length), sizeof(length));
+		out.write(reinterpret_cast< const char* >(value.data()), static_cast< std::streamsize >(length * sizeof(C)));
+	}
+
+	static string_type decode(std::istream& in)
+	{
+		std::uint64_t length = 0;
+		if (!in.read(reinterpret_cast< char* >(&length), sizeof(length)))
+		{
+			throw std::runtime_error("BucketCodec: truncated stream");
+		}
+		string_type value;
+		for (std::uint64_t done = 0; done < length;)
+		{
+			std::uint64_t chunk = std::min< std::uint64_t >(length - done, 4096);
+			value.resize(done + chunk);
+			if (!in.read(reinterpret_cast< char* >(value.data() + done),
+						 static_cast< std::streamsize >(chunk * sizeof(C))))
+			{
+				throw std::runtime_error("BucketCodec: truncated stream");
+			}
+			done += chunk;
+		}
+		return value;
+	}
+};
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_CODEC_HPP
@@ -5,65 +5,106 @@
 #ifndef CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_ITERATOR_HPP
 #define CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_ITERATOR_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <limits>
+#include <span>
+#include <type_traits>
 #include <utility>
 
-template< typename T >
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
 class BucketStorage;
 
 template< typename T >
 class Node;
 
-template< typename T >
+template< typename T, std::size_t N >
 class Block;
 
-template< typename T >
+template< typename T, std::size_t N >
+class BlockIndex;
+
+template< typename T, std::size_t N = 0 >
 class ConstIterator
 {
   public:
-	using iterator_category = std::bidirectional_iterator_tag;
+	using iterator_category = std::random_access_iterator_tag;
 	using value_type = T;
 	using difference_type = std::ptrdiff_t;
 	using pointer = const T*;
 	using reference = const T&;
 
   private:
-	template< typename >
+	using size_type = std::size_t;
+
+	template< typename, typename, std::size_t, std::size_t >
 	friend class BucketStorage;
 
-	template< typename >
+	template< typename, std::size_t >
 	friend class Iterator;
 
-	ConstIterator() : current_block(nullptr), current_node(nullptr) {}
+	template< typename >
+	friend class BlockPartition;
+
+	std::pair< size_type, size_type > position() const
+	{
+		if (!current_node)
+		{
+			return { std::numeric_limits< size_type >::max(), 0 };
+		}
+		return { current_block->ordinal, static_cast< size_type >(current_node - current_block->nodes) };
+	}
+
+	size_type rank_in_block() const
+	{
+		if (current_node)
+		{
+			return current_block->rank_of(current_node);
+		}
+		return current_block->prev ? current_block->prev->block_size : 0;
+	}
+
+	ConstIterator& advance_in_block(difference_type distance)
+	{
+		Block< value_type, N >* block = current_node ? current_block : current_block->prev;
+		size_type rank = rank_in_block() + distance;
+		if (!block || rank == block->block_size)
+		{
+			current_block = block ? block->next : current_block;
+			current_node = nullptr;
+		}
+		else
+		{
+			current_block = block;
+			current_node = block->select(rank);
+		}
+		return *this;
+	}
 
-	ConstIterator(Node< value_type >* node, Block< value_type >* block)
+	ConstIterator(Node< value_type >* node, Block< value_type, N >* block)
 	{
 		current_node = node;
 		current_block = block;
 	}
 
   public:
-	reference operator*() const { return *(current_node->value_ptr); }
-	pointer operator->() const { return current_node->value_ptr; }
+	ConstIterator() : current_block(nullptr), current_node(nullptr) {}
+
+	reference operator*() const { return *(current_block->value_of(current_node)); }
+	pointer operator->() const { return current_block->value_of(current_node); }
 
 	ConstIterator& operator++()
 	{
-		if (current_node->next)
+		Node< value_type >* next = current_block->next_active(current_node);
+		if (next)
 		{
-			current_node = current_node->next;
+			current_node = next;
 		}
 		else
 		{
-			if (current_block->next->next)
-			{
-				current_block = current_block->next;
-				current_node = current_block->b_head;
-			}
-			else
-			{
-				current_block = current_block->next;
-				current_node = nullptr;
-			}
+			current_block = current_block->next;
+			current_node = current_block->first_active();
 		}
 		return *this;
 	}
@@ -77,31 +118,17 @@ class ConstIterator
 
 	ConstIterator& operator--()
 	{
-		if (current_node)
+		Node< value_type >* prev = current_node ? current_block->prev_active(current_node) : nullptr;
+		if (prev)
 		{
-			if (current_node->prev)
-			{
-				current_node = current_node->prev;
-			}
-			else
-			{
-				if (current_block->prev)
-				{
-					current_block = current_block->prev;
-					current_node = current_block->b_tail;
-				}
-				else
-				{
-					current_node = nullptr;
-				}
-			}
+			current_node = prev;
 		}
 		else
 		{
 			if (current_block->prev)
 			{
 				current_block = current_block->prev;
-				current_node = current_block->b_tail;
+				current_node = current_block->last_active();
 			}
 			else
 			{
@@ -118,9 +145,62 @@ class ConstIterator
 		return temp;
 	}
 
+	ConstIterator& operator+=(difference_type distance)
+	{
+		BlockIndex< value_type, N >* index = current_block->index;
+		if (!index)
+		{
+			return advance_in_block(distance);
+		}
+		size_type rank = index->rank(current_block, current_node) + distance;
+		if (rank == index->total)
+		{
+			current_block = index->sentinel;
+			current_node = nullptr;
+		}
+		else
+		{
+			current_block = index->find(rank);
+			current_node = current_block->select(rank);
+		}
+		return *this;
+	}
+
+	ConstIterator& operator-=(difference_type distance) { return *this += -distance; }
+
+	ConstIterator operator+(difference_type distance) const
+	{
+		ConstIterator temp = *this;
+		return temp += distance;
+	}
+
+	ConstIterator operator-(difference_type distance) const
+	{
+		ConstIterator temp = *this;
+		return temp -= distance;
+	}
+
+	friend ConstIterator operator+(difference_type distance, const ConstIterator& it) { return it + distance; }
+
+	difference_type operator-(const ConstIterator& other) const
+	{
+		BlockIndex< value_type, N >* index = current_block->index;
+		if (!index)
+		{
+			return static_cast< difference_type >(rank_in_block()) -
+				   static_cast< difference_type >(other.rank_in_block());
+		}
+		return static_cast< difference_type >(index->rank(current_block, current_node)) -
+			   static_cast< difference_type >(index->rank(other.current_block, other.current_node));
+	}
+
+	reference operator[](difference_type distance) const { return *(*this + distance); }
+
 	bool operator==(const ConstIterator& other) const { return current_node == other.current_node; }
 	bool operator!=(const ConstIterator& other) const { return current_node != other.current_node; }
 
+	friend bool operator==(const ConstIterator& it, std::default_sentinel_t) { return it.current_node == nullptr; }
+
 	ConstIterator& operator=(const ConstIterator& other)
 	{
 		if (this != &other)
@@ -153,90 +233,167 @@ class ConstIterator
 		return *this;
 	}
 
-	bool operator>(const ConstIterator& other) const
-	{
-		if (other.current_block->block_id == 0)
-		{
-			return false;
-		}
-		if (current_block->block_id == 0)
-		{
-			return true;
-		}
-		return current_node->node_id > other.current_node->node_id;
-	}
+	bool operator>(const ConstIterator& other) const { return position() > other.position(); }
 
-	bool operator<(const ConstIterator& other) const
-	{
-		if (other.current_block->block_id == 0)
-		{
-			if (current_block->block_id == 0)
-			{
-				return false;
-			}
-			return true;
-		}
-		return current_node->node_id < other.current_node->node_id;
-	}
+	bool operator<(const ConstIterator& other) const { return position() < other.position(); }
 
-	bool operator>=(const ConstIterator& other) const { return (*this > other) || (*this == other); }
+	bool operator>=(const ConstIterator& other) const { return position() >= other.position(); }
 
-	bool operator<=(const ConstIterator& other) const { return (*this < other) || (*this == other); }
+	bool operator<=(const ConstIterator& other) const { return position() <= other.position(); }
 
   protected:
-	Block< value_type >* current_block;
+	Block< value_type, N >* current_block;
 	Node< value_type >* current_node;
 
-	template< typename >
+	template< typename, typename, std::size_t, std::size_t >
 	friend class BucketStorage;
 };
 
-template< typename T >
-class Iterator : public ConstIterator< T >
+template< typename T, std::size_t N = 0 >
+class Iterator : public ConstIterator< T, N >
 {
   public:
-	using iterator_category = std::bidirectional_iterator_tag;
+	using iterator_category = std::random_access_iterator_tag;
 	using value_type = T;
 	using difference_type = std::ptrdiff_t;
 	using pointer = T*;
 	using reference = T&;
 
   private:
-	template< typename >
+	template< typename, typename, std::size_t, std::size_t >
 	friend class BucketStorage;
 
-	Iterator() : ConstIterator< T >() {}
-	Iterator(Node< value_type >* node, Block< value_type >* block) : ConstIterator< value_type >(node, block) {}
+	template< typename >
+	friend class BlockPartition;
+
+	Iterator(Node< value_type >* node, Block< value_type, N >* block) : ConstIterator< value_type, N >(node, block) {}
 
   public:
-	reference operator*() { return *(this->current_node->value_ptr); }
-	pointer operator->() { return this->current_node->value_ptr; }
+	Iterator() : ConstIterator< T, N >() {}
+
+	reference operator*() const { return *(this->current_block->value_of(this->current_node)); }
+	pointer operator->() const { return this->current_block->value_of(this->current_node); }
 
 	Iterator& operator++()
 	{
-		ConstIterator< T >::operator++();
+		ConstIterator< T, N >::operator++();
 		return *this;
 	}
 
 	Iterator operator++(int)
 	{
 		Iterator temp = *this;
-		ConstIterator< T >::operator++();
+		ConstIterator< T, N >::operator++();
 		return temp;
 	}
 
 	Iterator& operator--()
 	{
-		ConstIterator< T >::operator--();
+		ConstIterator< T, N >::operator--();
 		return *this;
 	}
 
 	Iterator operator--(int)
 	{
 		Iterator temp = *this;
-		ConstIterator< T >::operator--();
+		ConstIterator< T, N >::operator--();
+		return temp;
+	}
+
+	Iterator& operator+=(difference_type distance)
+	{
+		ConstIterator< T, N >::operator+=(distance);
+		return *this;
+	}
+
+	Iterator& operator-=(difference_type distance)
+	{
+		ConstIterator< T, N >::operator-=(distance);
+		return *this;
+	}
+
+	Iterator operator+(difference_type distance) const
+	{
+		Iterator temp = *this;
+		return temp += distance;
+	}
+
+	Iterator operator-(difference_type distance) const
+	{
+		Iterator temp = *this;
+		return temp -= distance;
+	}
+
+	friend Iterator operator+(difference_type distance, const Iterator& it) { return it + distance; }
+
+	using ConstIterator< T, N >::operator-;
+
+	reference operator[](difference_type distance) const { return *(*this + distance); }
+};
+
+template< bool Const, typename T, std::size_t N >
+class BlockView
+{
+  private:
+	using size_type = std::size_t;
+	using mask_type = std::uint64_t;
+	using element_type = std::conditional_t< Const, const T, T >;
+
+	template< bool, typename, std::size_t >
+	friend class BlockIterator;
+
+	const Block< T, N >* block;
+
+	explicit BlockView(const Block< T, N >* block) : block(block) {}
+
+  public:
+	[[nodiscard]] size_type size() const noexcept { return block->block_size; }
+	[[nodiscard]] size_type extent() const noexcept { return block->block_used; }
+	[[nodiscard]] bool occupied(size_type slot) const { return block->is_occupied(block->nodes + slot); }
+
+	[[nodiscard]] std::span< const mask_type > mask() const
+	{
+		return { block->occupancy, Block< T, N >::mask_words(block->block_used) };
+	}
+
+	[[nodiscard]] std::span< element_type > values() const { return { block->slots, block->block_used }; }
+};
+
+template< bool Const, typename T, std::size_t N >
+class BlockIterator
+{
+  public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = BlockView< Const, T, N >;
+	using difference_type = std::ptrdiff_t;
+
+  private:
+	template< typename, typename, std::size_t, std::size_t >
+	friend class BucketStorage;
+
+	const Block< T, N >* current_block;
+
+	explicit BlockIterator(const Block< T, N >* block) : current_block(block) {}
+
+  public:
+	BlockIterator() : current_block(nullptr) {}
+
+	value_type operator*() const { return value_type(current_block); }
+
+	BlockIterator& operator++()
+	{
+		current_block = current_block->next;
+		return *this;
+	}
+
+	BlockIterator operator++(int)
+	{
+		BlockIterator temp = *this;
+		++(*this);
 		return temp;
 	}
+
+	bool operator==(const BlockIterator& other) const { return current_block == other.current_block; }
 };
 
 #endif	  // CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_ITERATOR_HPP
@@ -0,0 +1,191 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_PARALLEL_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_PARALLEL_HPP
+
+#include "bucket_storage.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template< typename Storage >
+class BlockPartition
+{
+  public:
+	using size_type = std::size_t;
+	using value_type = typename std::remove_const_t< Storage >::value_type;
+	using iterator = std::conditional_t< std::is_const_v< Storage >,
+										 typename std::remove_const_t< Storage >::const_iterator,
+										 typename std::remove_const_t< Storage >::iterator >;
+	using reference = std::conditional_t< std::is_const_v< Storage >, const value_type&, value_type& >;
+
+	BlockPartition(Storage& storage, size_type parts) : storage(storage)
+	{
+		for (block_type* block = storage.head; block && block != storage.tail; block = block->next)
+		{
+			blocks.push_back(block);
+		}
+		parts = std::max< size_type >(1, std::min(parts, blocks.size()));
+		for (size_type i = 0; i <= parts; i++)
+		{
+			bounds.push_back(blocks.size() * i / parts);
+		}
+	}
+
+	[[nodiscard]] size_type size() const noexcept { return bounds.size() - 1; }
+
+	iterator end() const { return storage.end(); }
+
+	template< typename F >
+	iterator visit(size_type part, F&& f) const
+	{
+		for (size_type i = bounds[part]; i < bounds[part + 1]; i++)
+		{
+			block_type* block = blocks[i];
+			for (size_type word = 0; word < block->used_words(); word++)
+			{
+				for (auto bits = block->occupancy[word]; bits != 0; bits &= bits - 1)
+				{
+					Node< value_type >* node =
+						block->nodes + word * block_type::mask_bits + std::countr_zero(bits);
+					if (!f(static_cast< reference >(*(block->value_of(node)))))
+					{
+						return iterator(node, block);
+					}
+				}
+			}
+		}
+		return storage.end();
+	}
+
+  private:
+	using block_type = typename std::remove_const_t< Storage >::block_type;
+
+	Storage& storage;
+	std::vector< block_type* > blocks;
+	std::vector< size_type > bounds;
+};
+
+template< typename T, typename A, std::size_t N, std::size_t M, typename F >
+void parallel_for_each(BucketStorage< T, A, N, M >& storage, F f, ThreadPool& pool = ThreadPool::shared())
+{
+	BlockPartition< BucketStorage< T, A, N, M > > partition(storage, pool.size() * 4);
+	pool.run(partition.size(),
+			 [&partition, &f](std::size_t part)
+			 {
+				 partition.visit(part,
+								 [&f](T& value)
+								 {
+									 f(value);
+									 return true;
+								 });
+			 });
+}
+
+template< typename Storage, typename Predicate >
+auto parallel_find_if(Storage& storage, Predicate pred, ThreadPool& pool = ThreadPool::shared())
+{
+	using partition_type = BlockPartition< Storage >;
+	partition_type partition(storage, pool.size() * 4);
+	std::vector< typename partition_type::iterator > found(partition.size(), partition.end());
+	std::atomic< std::size_t > first(partition.size());
+	pool.run(partition.size(),
+			 [&](std::size_t part)
+			 {
+				 if (part > first.load(std::memory_order_relaxed))
+				 {
+					 return;
+				 }
+				 found[part] = partition.visit(part,
+											   [&](typename partition_type::reference value)
+											   { return !pred(value) && part <= first.load(std::memory_order_relaxed); });
+				 if (found[part] != partition.end())
+				 {
+					 std::size_t expected = first.load(std::memory_order_relaxed);
+					 while (part < expected && !first.compare_exchange_weak(expected, part))
+					 {
+					 }
+				 }
+			 });
+	std::size_t part = first.load();
+	return part < found.size() ? found[part] : partition.end();
+}
+
+template< typename Storage, typename U >
+auto parallel_find(Storage& storage, const U& value, ThreadPool& pool = ThreadPool::shared())
+{
+	return parallel_find_if(
+		storage,
+		[&value](const auto& element) { return element == value; },
+		pool);
+}
+
+template< typename T, typename A, std::size_t N, std::size_t M, typename Predicate >
+std::size_t parallel_count_if(const BucketStorage< T, A, N, M >& storage,
+							  Predicate pred,
+							  ThreadPool& pool = ThreadPool::shared())
+{
+	BlockPartition< const BucketStorage< T, A, N, M > > partition(storage, pool.size() * 4);
+	std::vector< std::size_t > counts(partition.size(), 0);
+	pool.run(partition.size(),
+			 [&](std::size_t part)
+			 {
+				 std::size_t count = 0;
+				 partition.visit(part,
+								 [&](const T& value)
+								 {
+									 count += pred(value) ? 1 : 0;
+									 return true;
+								 });
+				 counts[part] = count;
+			 });
+	std::size_t total = 0;
+	for (std::size_t count : counts)
+	{
+		total += count;
+	}
+	return total;
+}
+
+template< typename T, typename A, std::size_t N, std::size_t M, typename R, typename Reduce, typename Transform >
+R parallel_transform_reduce(const BucketStorage< T, A, N, M >& storage,
+							R init,
+							Reduce reduce,
+							Transform transform,
+							ThreadPool& pool = ThreadPool::shared())
+{
+	BlockPartition< const BucketStorage< T, A, N, M > > partition(storage, pool.size() * 4);
+	std::vector< std::optional< R > > partial(partition.size());
+	pool.run(partition.size(),
+			 [&](std::size_t part)
+			 {
+				 partition.visit(part,
+								 [&](const T& value)
+								 {
+									 if (partial[part])
+									 {
+										 partial[part] = reduce(std::move(*partial[part]), transform(value));
+									 }
+									 else
+									 {
+										 partial[part].emplace(transform(value));
+									 }
+									 return true;
+								 });
+			 });
+	for (std::optional< R >& result : partial)
+	{
+		if (result)
+		{
+			init = reduce(std::move(init), std::move(*result));
+		}
+	}
+	return init;
+}
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_PARALLEL_HPP
@@ -5,18 +5,78 @@
 #ifndef CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_STORAGE_HPP
 #define CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_STORAGE_HPP
 
+#include "block_index.hpp"
+#include "bucket_codec.hpp"
 #include "bucket_iterator.hpp"
-#include "my_stack.hpp"
+#include "hole_index.hpp"
 #include "structs.hpp"
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
+#include <cerrno>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
-#include <iostream>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-template< typename T >
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP 1
+#endif
+
+struct BucketStorageStats
+{
+	std::size_t size;
+	std::size_t holes;
+	std::size_t blocks;
+	std::size_t spare_blocks;
+	std::vector< std::size_t > holes_histogram;
+	std::size_t bytes_used;
+	std::size_t bytes_overhead;
+	std::size_t block_allocations;
+	std::size_t block_frees;
+};
+
+struct BucketHandle
+{
+	std::size_t block = 0;
+	std::size_t slot = 0;
+	std::size_t generation = 0;
+
+	bool operator==(const BucketHandle& other) const = default;
+};
+
+struct SpareRetention
+{
+	std::size_t max_blocks = std::numeric_limits< std::size_t >::max();
+	double peak_fraction = 1.0;
+	bool eager = true;
+};
+
+inline constexpr std::size_t dynamic_block_capacity = 0;
+
+template<
+	typename T,
+	typename Allocator = std::allocator< T >,
+	std::size_t Capacity = dynamic_block_capacity,
+	std::size_t Inline = 0 >
 class BucketStorage
 {
   public:
@@ -26,175 +86,574 @@ class BucketStorage
 	using reference = T&;
 	using difference_type = std::ptrdiff_t;
 	using const_reference = const T&;
+	using allocator_type = Allocator;
+
+	using iterator = Iterator< value_type, Capacity >;
+	using const_iterator = ConstIterator< value_type, Capacity >;
+	using handle = BucketHandle;
+	using block_view = BlockView< false, value_type, Capacity >;
+	using const_block_view = BlockView< true, value_type, Capacity >;
+	using block_range = std::ranges::subrange< BlockIterator< false, value_type, Capacity > >;
+	using const_block_range = std::ranges::subrange< BlockIterator< true, value_type, Capacity > >;
 
-	using iterator = Iterator< value_type >;
-	using const_iterator = ConstIterator< value_type >;
+	static constexpr bool fixed_capacity = Capacity != dynamic_block_capacity;
+	static constexpr size_type default_block_capacity = fixed_capacity ? Capacity : 64;
+	static constexpr size_type inline_capacity = Inline;
 
 	BucketStorage(const BucketStorage& other);
+	BucketStorage(const BucketStorage& other, const allocator_type& allocator);
 	BucketStorage(BucketStorage&& other) noexcept;
-	explicit BucketStorage(size_type block_capacity = 64);
+	BucketStorage(BucketStorage&& other, const allocator_type& allocator);
+	explicit BucketStorage(
+		size_type block_capacity = default_block_capacity,
+		const allocator_type& allocator = allocator_type());
+	explicit BucketStorage(const allocator_type& allocator);
 	BucketStorage& operator=(const BucketStorage& other);
-	BucketStorage& operator=(BucketStorage&& other) noexcept;
+	BucketStorage& operator=(BucketStorage&& other) noexcept(
+		std::allocator_traits< Allocator >::propagate_on_container_move_assignment::value ||
+		std::allocator_traits< Allocator >::is_always_equal::value);
 	~BucketStorage();
 
   private:
+	using alloc_traits = std::allocator_traits< allocator_type >;
+	using block_type = Block< value_type, Capacity >;
+	using block_allocator = typename alloc_traits::template rebind_alloc< block_type >;
+	using block_traits = std::allocator_traits< block_allocator >;
+	using chunk_type = typename block_type::chunk_type;
+	using chunk_allocator = typename alloc_traits::template rebind_alloc< chunk_type >;
+	using chunk_traits = std::allocator_traits< chunk_allocator >;
+	using index_type = BlockTable< value_type, allocator_type, Capacity >;
+	using index_allocator = typename alloc_traits::template rebind_alloc< index_type >;
+	using index_traits = std::allocator_traits< index_allocator >;
+	using id_list = std::vector< size_type, typename alloc_traits::template rebind_alloc< size_type > >;
+
+	struct SnapshotHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t value_size;
+		std::uint32_t value_alignment;
+		std::uint32_t node_size;
+		std::uint64_t block_capacity;
+		std::uint64_t size;
+		std::uint64_t id_node;
+		std::uint64_t id_block;
+		std::uint64_t block_count;
+	};
+
+	struct SnapshotBlock
+	{
+		std::uint64_t block_id;
+		std::uint64_t block_capacity;
+		std::uint64_t block_used;
+		std::uint64_t block_size;
+		std::uint64_t offset;
+	};
+
+	static constexpr char snapshot_magic[8] = { 'B', 'U', 'C', 'K', 'E', 'T', 'S', 'T' };
+	static constexpr char stream_magic[8] = { 'B', 'U', 'C', 'K', 'E', 'T', 'S', 'R' };
+	static constexpr std::uint32_t snapshot_version = 1;
+	static constexpr size_type stream_chunk = 4096;
+
+	static_assert(!fixed_capacity || Inline == 0 || Inline == Capacity,
+				  "BucketStorage: inline block capacity must match the fixed block capacity");
+	static_assert(Inline == 0 || std::is_nothrow_move_constructible_v< T >,
+				  "BucketStorage: an inline block requires a nothrow move constructible element type");
+
+	struct InlineBlock
+	{
+		alignas(block_type) unsigned char block[sizeof(block_type)];
+		chunk_type buffer[block_type::storage_chunks(Inline)];
+		bool used = false;
+
+		block_type* create(size_type id)
+		{
+			used = true;
+			return ::new (static_cast< void* >(block)) block_type(id, Inline, buffer);
+		}
+
+		block_type* get() noexcept { return std::launder(reinterpret_cast< block_type* >(block)); }
+
+		bool holds(const block_type* other) const noexcept
+		{
+			return static_cast< const void* >(other) == static_cast< const void* >(block);
+		}
+	};
+
+	struct NoInlineBlock
+	{
+		static constexpr bool used = true;
+
+		block_type* create(size_type) { return nullptr; }
+		block_type* get() noexcept { return nullptr; }
+		bool holds(const block_type*) const noexcept { return false; }
+	};
+
+	[[no_unique_address]] allocator_type alloc;
 	size_type current_size;
 	size_type block_capacity;
 	size_type current_capacity;
 	size_type id_node;
 	size_type id_block;
-	MyStack< Node< value_type > > deleted_nodes;
-	MyStack< Block< value_type > > deleted_blocks;
-	Block< value_type >* head;
-	Block< value_type >* tail;
+	id_list free_ids;
+	HoleIndex< value_type, allocator_type, Capacity > holes;
+	block_type* spare_head;
+	size_type spare_count;
+	block_type* head;
+	block_type* tail;
+	block_type sentinel;
+	[[no_unique_address]] std::conditional_t< (Inline > 0), InlineBlock, NoInlineBlock > inline_block;
+	index_type* index;
+	block_type* preferred;
+	block_type* compact_cursor;
+	SpareRetention retention;
+	size_type peak_blocks;
+	unsigned char* snapshot;
+	size_type snapshot_size;
+#ifdef BUCKET_STORAGE_ENABLE_STATS
+	size_type blocks_allocated = 0;
+	size_type blocks_freed = 0;
+#endif
 
 	void copy(const BucketStorage& other);
 	void move(BucketStorage&& other) noexcept;
-	iterator get_position(Node< value_type >* node);
-	iterator insert_impl(Node< value_type >* node);
+	void move_elements(BucketStorage&& other);
+	void release_all() noexcept;
+	void destroy_blocks() noexcept;
+	block_type* create_block(size_type id, size_type capacity);
+	void destroy_block(block_type* block) noexcept;
+	void drop_spare() noexcept;
+	size_type next_block_id();
+	void claim_block_id() noexcept;
+	void reclaim_block_ids();
+	void create_index();
+	void destroy_index() noexcept;
+	void attach_sentinel() noexcept;
+	void adopt_inline(BucketStorage& other) noexcept;
+	[[nodiscard]] size_type linked_blocks() const noexcept;
 
-	template< typename >
+	static size_type capacity_of(const block_type* block) noexcept
+	{
+		if constexpr (fixed_capacity)
+		{
+			return Capacity;
+		}
+		else
+		{
+			return block->block_capacity;
+		}
+	}
+
+	void index_add(const block_type* block, difference_type delta) noexcept
+	{
+		if (index)
+		{
+			index->add(block, delta);
+		}
+	}
+	void release_snapshot() noexcept;
+	static void check_snapshot(const SnapshotHeader& header, size_type file_size);
+	static void check_snapshot(const SnapshotBlock& entry, size_type id_block, size_type file_size);
+	void restore_block(const SnapshotBlock& entry, chunk_type* buffer);
+	std::pair< block_type*, Node< value_type >* > get_position(block_type* hint);
+	void link_block(block_type* block);
+	void release_block(block_type* block);
+	void push_spare(block_type* block) noexcept;
+	block_type* pop_spare() noexcept;
+	void push_free_node(block_type* block, Node< value_type >* node);
+	void take_free_node(block_type* block);
+	std::pair< block_type*, Node< value_type >* > find_node(const handle& h) const noexcept;
+	void update_peak() noexcept;
+	void erase_block(block_type* block) noexcept;
+	template< typename Pred >
+	size_type erase_nodes(
+		block_type* block, Node< value_type >* first, const Node< value_type >* last, Pred& pred);
+	template< typename Pred >
+	size_type erase_matching(Pred& pred);
+	[[nodiscard]] size_type spare_limit() const noexcept;
+
+	template< typename... Args >
+	iterator insert_impl(block_type* hint, Args&&... args);
+
+	template< std::input_iterator I, std::sentinel_for< I > S >
+	void insert_bulk(I first, S last);
+
+	template< typename, std::size_t >
 	friend class ConstIterator;
 
-	template< typename >
+	template< typename, std::size_t >
 	friend class Iterator;
 
 	template< typename >
 	friend class Node;
 
+	template< typename >
+	friend class BlockPartition;
+
+	template< typename U, typename A, std::size_t N, std::size_t M, typename Pred >
+	friend typename BucketStorage< U, A, N, M >::size_type erase_if(BucketStorage< U, A, N, M >& storage, Pred pred);
+
   public:
 	iterator end() noexcept { return iterator(nullptr, tail); }
-	iterator begin() noexcept { return iterator(head ? head->b_head : nullptr, head); }
+	iterator begin() noexcept { return head ? iterator(head->first_active(), head) : end(); }
 	const_iterator end() const noexcept { return const_iterator(nullptr, tail); }
-	const_iterator begin() const noexcept { return const_iterator(head ? head->b_head : nullptr, head); }
+	const_iterator begin() const noexcept { return head ? const_iterator(head->first_active(), head) : end(); }
 	const_iterator cend() const noexcept { return const_iterator(nullptr, tail); }
-	const_iterator cbegin() const noexcept { return const_iterator(head ? head->b_head : nullptr, head); }
+	const_iterator cbegin() const noexcept { return begin(); }
+
+	block_range blocks() noexcept;
+	const_block_range blocks() const noexcept;
+
+	allocator_type get_allocator() const noexcept { return alloc; }
 
 	iterator insert(const value_type& value);
 	iterator insert(value_type&& value);
+	template< std::input_iterator InputIt >
+	void insert(InputIt first, InputIt last);
+	template< std::ranges::input_range R >
+	void insert_range(R&& range);
+	template< typename... Args >
+	iterator emplace(Args&&... args);
+	template< typename... Args >
+	iterator emplace_hint(const_iterator hint, Args&&... args);
 	iterator erase(const_iterator it);
+	iterator erase(const_iterator first, const_iterator last);
+	bool erase(const handle& h);
+	[[nodiscard]] handle handle_of(const_iterator it) const noexcept;
+	[[nodiscard]] value_type* get(const handle& h) noexcept;
+	[[nodiscard]] const value_type* get(const handle& h) const noexcept;
 	[[nodiscard]] bool empty() const noexcept;
 	[[nodiscard]] size_type size() const noexcept;
 	[[nodiscard]] size_type capacity() const noexcept;
 	void swap(BucketStorage& other) noexcept;
 	void clear();
+	void reserve(size_type new_capacity);
 	iterator get_to_distance(iterator it, difference_type distance);
+	void set_reuse_policy(ReusePolicy policy);
+	[[nodiscard]] ReusePolicy reuse_policy() const noexcept;
 	void shrink_to_fit();
+	void set_spare_retention(const SpareRetention& policy);
+	[[nodiscard]] SpareRetention spare_retention() const noexcept;
+	void trim() noexcept;
+	size_type compact_step(size_type max_moves);
+	template< typename Relocate >
+	size_type compact_step(size_type max_moves, Relocate&& on_relocate);
+	[[nodiscard]] BucketStorageStats stats() const;
+	static constexpr size_type capacity_for(size_type bytes) noexcept;
+	template< typename Codec = BucketCodec< T > >
+	void serialize(std::ostream& out, Codec codec = Codec()) const;
+	template< typename Codec = BucketCodec< T > >
+	void deserialize(std::istream& in, Codec codec = Codec());
+	void save(const std::string& path) const
+		requires std::is_trivially_copyable_v< T >;
+#ifdef CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP
+	static BucketStorage map(const std::string& path, const allocator_type& allocator = allocator_type())
+		requires std::is_trivially_copyable_v< T >;
+#endif
 };
 
 template< typename T >
-typename BucketStorage< T >::iterator BucketStorage< T >::insert_impl(Node< value_type >* node)
-{
-	iterator res_it = get_position(node);
-	Block< value_type >* res_block = res_it.current_block;
-	current_size++;
+using PmrBucketStorage = BucketStorage< T, std::pmr::polymorphic_allocator< T > >;
+
+template< typename T, std::size_t N, typename Allocator = std::allocator< T > >
+using FixedBucketStorage = BucketStorage< T, Allocator, N >;
 
-	node->node_id = node->node_id == 0 ? ++id_node : res_it.current_node->node_id;
+template< typename T, std::size_t N, typename Allocator = std::allocator< T > >
+using SmallBucketStorage = BucketStorage< T, Allocator, dynamic_block_capacity, N >;
 
-	node->is_active = true;
-	node->block = res_block;
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename... Args >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::insert_impl(block_type* hint, Args&&... args)
+{
+	auto [block, node] = get_position(hint);
+	try
+	{
+		alloc_traits::construct(alloc, block->value_of(node), std::forward< Args >(args)...);
+	} catch (...)
+	{
+		if (block->block_size == 0)
+		{
+			release_block(block);
+		}
+		throw;
+	}
 
-	iterator it(node, res_block);
+	bool fresh = node == block->nodes + block->block_used;
+	if (fresh)
+	{
+		block->block_used++;
+	}
+	block->set_occupied(node, true);
+	block->block_size++;
+	if (!fresh)
+	{
+		take_free_node(block);
+	}
+	node->node_id = ++id_node;
+	index_add(block, 1);
+	current_size++;
+	preferred = block;
 
-	return it;
+	return iterator(node, block);
 }
 
-template< typename T >
-typename BucketStorage< T >::iterator BucketStorage< T >::get_position(Node< value_type >* node)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+std::pair< Block< T, Capacity >*, Node< T >* > BucketStorage< T, Allocator, Capacity, Inline >::get_position(
+	block_type* hint)
 {
-	try
+	if (!hint && holes.policy == ReusePolicy::hint)
 	{
-		Block< value_type >* res_block;
-
-		if (deleted_nodes.size() != 0)
+		hint = preferred;
+	}
+	if (hint && hint->is_active && hint->block_size < capacity_of(hint))
+	{
+		if (hint->block_used < capacity_of(hint))
 		{
-			Node< value_type >* d_node = deleted_nodes.pop();
-			node->prev = d_node->prev;
-			node->next = d_node->next;
-			node->block = d_node->block;
-			node->node_id = d_node->node_id;
-			node->is_active = true;
-			if (node->prev)
-			{
-				node->prev->next = node;
-			}
-			if (node->next)
-			{
-				node->next->prev = node;
-			}
-			if (node->block->block_id == deleted_blocks.last()->block_id)
-			{
-				res_block = deleted_blocks.pop();
-				current_capacity += block_capacity;
-				res_block->is_active = true;
-			}
-			else
-			{
-				res_block = d_node->block;
-			}
+			return { hint, hint->nodes + hint->block_used };
 		}
-		else
-		{
-			if (tail->prev && tail->prev->block_size < block_capacity)
-			{
-				res_block = tail->prev;
-			}
-			else
-			{
-				res_block = new Block< value_type >(++id_block);
-				current_capacity += block_capacity;
-				if (tail->prev == nullptr)
-				{
-					head = res_block;
-				}
-				res_block->next = tail;
-				res_block->prev = tail->prev;
-				tail->prev = res_block;
-			}
+		return { hint, hint->free_head };
+	}
 
-			if (res_block->b_tail)
-			{
-				node->prev = res_block->b_tail;
-				res_block->b_tail->next = node;
-			}
-			else
-			{
-				res_block->b_head = node;
-			}
-			res_block->b_tail = node;
-		}
+	if (block_type* block = holes.pick())
+	{
+		return { block, block->free_head };
+	}
 
-		if (res_block->next)
+	block_type* res_block = tail->prev;
+	if (res_block == nullptr || res_block->block_used == capacity_of(res_block))
+	{
+		if (spare_count != 0)
 		{
-			res_block->next->prev = res_block;
+			res_block = pop_spare();
+			res_block->is_active = true;
 		}
-		if (res_block->prev)
+		else if (!inline_block.used)
 		{
-			res_block->prev->next = res_block;
+			res_block = inline_block.create(next_block_id());
+			claim_block_id();
 		}
-		if (node->next)
+		else
 		{
-			node->next->prev = node;
+			res_block = create_block(next_block_id(), block_capacity);
+			claim_block_id();
 		}
-		if (node->prev)
+		try
 		{
-			node->prev->next = node;
+			link_block(res_block);
+		} catch (...)
+		{
+			res_block->is_active = false;
+			push_spare(res_block);
+			throw;
 		}
+	}
 
-		node->block = res_block;
-		res_block->block_size++;
+	return { res_block, res_block->nodes + res_block->block_used };
+}
 
-		return iterator(node, res_block);
-	} catch (std::bad_alloc& n)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::link_block(block_type* block)
+{
+	if (!index && (head || !inline_block.holds(block)))
 	{
-		std::cerr << "Error not enough memory: " << n.what() << std::endl;
-		clear();
-		throw n;
+		create_index();
+	}
+	if (index)
+	{
+		holes.reserve(index->blocks.size() + 1);
+		index->push_back(block);
+	}
+	else
+	{
+		block->ordinal = 0;
+	}
+	if (tail->prev == nullptr)
+	{
+		head = block;
+	}
+	else
+	{
+		tail->prev->next = block;
 	}
+	block->prev = tail->prev;
+	block->next = tail;
+	block->index = index;
+	tail->prev = block;
+	current_capacity += capacity_of(block);
+	update_peak();
 }
 
-template< typename T >
-void BucketStorage< T >::shrink_to_fit()
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::release_block(block_type* block)
+{
+	if (block->free_head)
+	{
+		holes.remove(block);
+		block->free_head = nullptr;
+	}
+	if (preferred == block)
+	{
+		preferred = nullptr;
+	}
+	if (compact_cursor == block)
+	{
+		compact_cursor = block->prev;
+	}
+	if (index)
+	{
+		index->erase(block);
+	}
+	block->block_used = 0;
+	block->block_size = 0;
+	block->is_active = false;
+
+	if (block->prev)
+	{
+		block->prev->next = block->next;
+	}
+	else
+	{
+		head = block->next == tail ? nullptr : block->next;
+	}
+	block->next->prev = block->prev;
+	block->next = nullptr;
+	block->prev = nullptr;
+	current_capacity -= capacity_of(block);
+	push_spare(block);
+	if (retention.eager)
+	{
+		trim();
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::push_spare(block_type* block) noexcept
+{
+	block->next = spare_head;
+	spare_head = block;
+	spare_count++;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+Block< T, Capacity >* BucketStorage< T, Allocator, Capacity, Inline >::pop_spare() noexcept
+{
+	block_type* block = spare_head;
+	spare_head = block->next;
+	block->next = nullptr;
+	spare_count--;
+	return block;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::update_peak() noexcept
+{
+	peak_blocks = std::max(peak_blocks, linked_blocks() + spare_count);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::linked_blocks() const noexcept
+{
+	return index ? index->blocks.size() - index->vacant : head != nullptr;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::spare_limit() const noexcept
+{
+	double fraction = std::clamp(retention.peak_fraction, 0.0, 1.0);
+	return std::min(retention.max_blocks, static_cast< size_type >(fraction * static_cast< double >(peak_blocks)));
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::set_spare_retention(const SpareRetention& policy)
+{
+	retention = policy;
+	if (retention.eager)
+	{
+		trim();
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+SpareRetention BucketStorage< T, Allocator, Capacity, Inline >::spare_retention() const noexcept
+{
+	return retention;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::trim() noexcept
+{
+	size_type limit = spare_limit();
+	while (spare_count > limit)
+	{
+		drop_spare();
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::push_free_node(
+	block_type* block,
+	Node< value_type >* node)
+{
+	if (compact_cursor && block->ordinal < compact_cursor->ordinal)
+	{
+		compact_cursor = block;
+	}
+	bool listed = block->free_head != nullptr;
+	node->next_free = block->free_head;
+	block->free_head = node;
+	if (listed)
+	{
+		holes.update(block, true);
+	}
+	else
+	{
+		holes.add(block);
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::take_free_node(block_type* block)
+{
+	Node< value_type >* node = block->free_head;
+	block->free_head = node->next_free;
+	node->next_free = nullptr;
+	if (block->free_head)
+	{
+		holes.update(block, false);
+	}
+	else
+	{
+		holes.remove(block);
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::set_reuse_policy(ReusePolicy policy)
+{
+	holes.clear();
+	holes.policy = policy;
+	holes.reserve(index ? index->blocks.size() : 0);
+	for (block_type* block = head; block && block != tail; block = block->next)
+	{
+		if (block->free_head)
+		{
+			holes.add(block);
+		}
+	}
+	preferred = nullptr;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+ReusePolicy BucketStorage< T, Allocator, Capacity, Inline >::reuse_policy() const noexcept
+{
+	return holes.policy;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::shrink_to_fit()
 {
 	if (current_size == 0)
 	{
@@ -202,30 +661,80 @@ void BucketStorage< T >::shrink_to_fit()
 		return;
 	}
 
-	size_type new_size;
-
-	size_type count = 1;
-
-	while (current_size > block_capacity * count)
+	compact_step(current_size);
+	while (spare_count != 0)
 	{
-		count++;
+		drop_spare();
 	}
-	new_size = block_capacity * count;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::compact_step(size_type max_moves)
+{
+	return compact_step(max_moves, [](const value_type*, iterator) {});
+}
 
-	BucketStorage new_storage(new_size);
-	iterator it = begin();
-	for (it; it != end(); ++it)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename Relocate >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::compact_step(size_type max_moves, Relocate&& on_relocate)
+{
+	size_type moves = 0;
+	block_type* dst_block = compact_cursor ? compact_cursor : head;
+	while (dst_block && moves < max_moves)
 	{
-		new_storage.insert(*it);
+		block_type* src_block = tail->prev;
+		while (dst_block != src_block && dst_block->block_size == dst_block->block_used)
+		{
+			dst_block = dst_block->next;
+		}
+		if (dst_block == src_block)
+		{
+			break;
+		}
+
+		Node< value_type >* dst = dst_block->free_head;
+		Node< value_type >* src = src_block->last_active();
+		value_type* moved = src_block->value_of(src);
+		alloc_traits::construct(alloc, dst_block->value_of(dst), std::move(*moved));
+		dst_block->set_occupied(dst, true);
+		dst_block->block_size++;
+		take_free_node(dst_block);
+		dst->node_id = ++id_node;
+		index_add(dst_block, 1);
+
+		alloc_traits::destroy(alloc, moved);
+		src_block->set_occupied(src, false);
+		index_add(src_block, -1);
+		if (--src_block->block_size == 0)
+		{
+			release_block(src_block);
+		}
+		else
+		{
+			push_free_node(src_block, src);
+		}
+		moves++;
+
+		on_relocate(static_cast< const value_type* >(moved), iterator(dst, dst_block));
 	}
-	*this = std::move(new_storage);
+	compact_cursor = dst_block;
+	return moves;
 }
 
-template< typename T >
-typename BucketStorage< T >::iterator
-	BucketStorage< T >::get_to_distance(BucketStorage::iterator it, const BucketStorage::difference_type distance)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::get_to_distance(BucketStorage::iterator it,
+																	 const BucketStorage::difference_type distance)
 {
 	iterator result = it;
+	difference_type rank = it - begin();
+	if (rank + distance >= 0 && rank + distance <= static_cast< difference_type >(current_size))
+	{
+		return result += distance;
+	}
+
 	if (distance > 0)
 	{
 		for (difference_type i = 0; i < distance; i++)
@@ -244,40 +753,127 @@ typename BucketStorage< T >::iterator
 	return result;
 }
 
-template< typename T >
-void BucketStorage< T >::swap(BucketStorage& other) noexcept
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::swap(BucketStorage& other) noexcept
 {
+	if constexpr (Inline > 0)
+	{
+		BucketStorage temp(std::move(other));
+		other.release_all();
+		other.move(std::move(*this));
+		release_all();
+		move(std::move(temp));
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+		{
+			std::swap(alloc, other.alloc);
+		}
+		return;
+	}
 	std::swap(current_size, other.current_size);
 	std::swap(block_capacity, other.block_capacity);
 	std::swap(current_capacity, other.current_capacity);
 	std::swap(id_block, other.id_block);
 	std::swap(id_node, other.id_node);
+	free_ids.swap(other.free_ids);
 	std::swap(head, other.head);
-	std::swap(tail, other.tail);
-	deleted_blocks.swap(other.deleted_blocks);
-	deleted_nodes.swap(other.deleted_nodes);
+	std::swap(tail->prev, other.tail->prev);
+	std::swap(index, other.index);
+	attach_sentinel();
+	other.attach_sentinel();
+	std::swap(snapshot, other.snapshot);
+	std::swap(snapshot_size, other.snapshot_size);
+#ifdef BUCKET_STORAGE_ENABLE_STATS
+	std::swap(blocks_allocated, other.blocks_allocated);
+	std::swap(blocks_freed, other.blocks_freed);
+#endif
+	std::swap(spare_head, other.spare_head);
+	std::swap(spare_count, other.spare_count);
+	holes.swap(other.holes);
+	std::swap(preferred, other.preferred);
+	std::swap(compact_cursor, other.compact_cursor);
+	std::swap(retention, other.retention);
+	std::swap(peak_blocks, other.peak_blocks);
+	if constexpr (alloc_traits::propagate_on_container_swap::value)
+	{
+		std::swap(alloc, other.alloc);
+	}
 }
 
-template< typename T >
-typename BucketStorage< T >::size_type BucketStorage< T >::capacity() const noexcept
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+constexpr typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::capacity_for(size_type bytes) noexcept
+{
+	size_type capacity = bytes / (sizeof(value_type) + sizeof(Node< value_type >));
+	while (capacity > 0 && block_type::storage_chunks(capacity) * sizeof(chunk_type) > bytes)
+	{
+		capacity--;
+	}
+	return capacity;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorageStats BucketStorage< T, Allocator, Capacity, Inline >::stats() const
+{
+	BucketStorageStats result{};
+	result.size = current_size;
+	size_type block_bytes = sizeof(block_type);
+	size_type allocated = 0;
+	for (block_type* block = head; block && block != tail; block = block->next)
+	{
+		size_type holes = block->block_used - block->block_size;
+		auto bucket = static_cast< size_type >(std::bit_width(holes));
+		if (result.holes_histogram.size() <= bucket)
+		{
+			result.holes_histogram.resize(bucket + 1, 0);
+		}
+		result.holes_histogram[bucket]++;
+		result.holes += holes;
+		result.blocks++;
+		allocated += block_bytes + block_type::storage_chunks(block->block_capacity) * sizeof(chunk_type);
+	}
+	for (block_type* spare = spare_head; spare; spare = spare->next)
+	{
+		result.spare_blocks++;
+		allocated += block_bytes + block_type::storage_chunks(spare->block_capacity) * sizeof(chunk_type);
+	}
+	if (index)
+	{
+		allocated += sizeof(index_type) + index->tree.capacity() * sizeof(size_type) +
+					 (index->blocks.capacity() + index->by_id.capacity()) * sizeof(block_type*);
+	}
+	allocated += holes.heap.capacity() * sizeof(block_type*) + free_ids.capacity() * sizeof(size_type);
+	result.bytes_used = current_size * sizeof(value_type);
+	result.bytes_overhead = allocated - result.bytes_used;
+#ifdef BUCKET_STORAGE_ENABLE_STATS
+	result.block_allocations = blocks_allocated;
+	result.block_frees = blocks_freed;
+#endif
+	return result;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::capacity() const noexcept
 {
 	return current_capacity;
 }
 
-template< typename T >
-typename BucketStorage< T >::size_type BucketStorage< T >::size() const noexcept
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::size() const noexcept
 {
 	return current_size;
 }
 
-template< typename T >
-bool BucketStorage< T >::empty() const noexcept
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+bool BucketStorage< T, Allocator, Capacity, Inline >::empty() const noexcept
 {
 	return current_size == 0;
 }
 
-template< typename T >
-typename BucketStorage< T >::iterator BucketStorage< T >::erase(BucketStorage::const_iterator it)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::erase(BucketStorage::const_iterator it)
 {
 	if (current_size - 1 == 0)
 	{
@@ -286,437 +882,1308 @@ typename BucketStorage< T >::iterator BucketStorage< T >::erase(BucketStorage::c
 	}
 	current_size--;
 
-	Block< value_type >* current_block = it.current_block;
-	current_block->block_size--;
+	const_iterator next = it;
+	++next;
+
+	block_type* current_block = it.current_block;
 	Node< value_type >* current_node = it.current_node;
-	current_node->is_active = false;
-	delete current_node->value_ptr;
-	current_node->value_ptr = nullptr;
-	deleted_nodes.push(current_node);
-	if (current_node->prev)
+	alloc_traits::destroy(alloc, current_block->value_of(current_node));
+	current_block->set_occupied(current_node, false);
+	index_add(current_block, -1);
+	if (--current_block->block_size == 0)
 	{
-		if (current_node->next)
-		{
-			current_node->prev->next = current_node->next;
-			current_node->next->prev = current_node->prev;
-		}
-		else
-		{
-			current_node->prev->next = nullptr;
-			current_block->b_tail = current_node->prev;
-		}
+		release_block(current_block);
 	}
 	else
 	{
-		if (current_node->next)
-		{
-			current_node->next->prev = nullptr;
-			current_block->b_head = current_node->next;
-		}
+		push_free_node(current_block, current_node);
+	}
+
+	return iterator(next.current_node, next.current_block);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::erase(const_iterator first, const_iterator last)
+{
+	if (first == last)
+	{
+		return iterator(last.current_node, last.current_block);
+	}
+	if (first == cbegin() && last == cend())
+	{
+		clear();
+		return end();
+	}
+
+	auto always = [](const value_type&) { return true; };
+	block_type* block = first.current_block;
+	Node< value_type >* node = first.current_node;
+	for (; block != last.current_block; node = block->first_active())
+	{
+		block_type* next = block->next;
+		if (node == block->first_active())
+		{
+			erase_block(block);
+		}
 		else
 		{
-			current_block->b_head = nullptr;
-			current_block->b_tail = nullptr;
-			current_block->is_active = false;
-			deleted_blocks.push(current_block);
-			current_capacity -= block_capacity;
-			if (current_block->prev)
-			{
-				current_block->prev->next = current_block->next;
-				current_block->next->prev = current_block->prev;
-			}
-			else
-			{
-				current_block->next->prev = nullptr;
-				head = current_block->next;
-			}
+			erase_nodes(block, node, nullptr, always);
 		}
+		block = next;
 	}
+	if (node != last.current_node)
+	{
+		erase_nodes(block, node, last.current_node, always);
+	}
+	return iterator(last.current_node, last.current_block);
+}
 
-	++it;
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+bool BucketStorage< T, Allocator, Capacity, Inline >::erase(const handle& h)
+{
+	auto [block, node] = find_node(h);
+	if (!node)
+	{
+		return false;
+	}
+	erase(const_iterator(node, block));
+	return true;
+}
 
-	return iterator(it.current_node, it.current_block);
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::handle
+	BucketStorage< T, Allocator, Capacity, Inline >::handle_of(const_iterator it) const noexcept
+{
+	const block_type* block = it.current_block;
+	size_type slot = it.current_node - block->nodes;
+	return handle{ block->block_id, slot, it.current_node->node_id };
 }
 
-template< typename T >
-typename BucketStorage< T >::iterator BucketStorage< T >::insert(value_type&& value)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+T* BucketStorage< T, Allocator, Capacity, Inline >::get(const handle& h) noexcept
 {
-	try
-	{
-		auto* res_node = new Node< value_type >();
-		res_node->value_ptr = new value_type(std::move(value));
-		return insert_impl(res_node);
-	} catch (std::bad_alloc& n)
+	auto [block, node] = find_node(h);
+	return node ? block->value_of(node) : nullptr;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+const T* BucketStorage< T, Allocator, Capacity, Inline >::get(const handle& h) const noexcept
+{
+	auto [block, node] = find_node(h);
+	return node ? block->value_of(node) : nullptr;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+std::pair< Block< T, Capacity >*, Node< T >* >
+	BucketStorage< T, Allocator, Capacity, Inline >::find_node(const handle& h) const noexcept
+{
+	block_type* block = index ? index->find_id(h.block) : head;
+	if (!block || block->block_id != h.block || h.slot >= block->block_used)
 	{
-		std::cerr << "Error not enough memory: " << n.what() << std::endl;
-		clear();
-		throw n;
+		return { block, nullptr };
 	}
+	Node< value_type >* node = block->nodes + h.slot;
+	return { block, block->is_occupied(node) && node->node_id == h.generation ? node : nullptr };
 }
 
-template< typename T >
-typename BucketStorage< T >::iterator BucketStorage< T >::insert(const value_type& value)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::erase_block(block_type* block) noexcept
 {
+	current_size -= block->block_size;
+	index_add(block, -static_cast< difference_type >(block->block_size));
+	block->destroy_values(alloc);
+	release_block(block);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename Pred >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::erase_nodes(
+		block_type* block,
+		Node< value_type >* first,
+		const Node< value_type >* last,
+		Pred& pred)
+{
+	size_type erased = 0;
+	auto settle = [&]
+	{
+		current_size -= erased;
+		index_add(block, -static_cast< difference_type >(erased));
+		if (block->block_size == 0)
+		{
+			release_block(block);
+		}
+	};
 	try
 	{
-		auto* res_node = new Node< value_type >();
-		res_node->value_ptr = new value_type(value);
-		return insert_impl(res_node);
-	} catch (std::bad_alloc& n)
+		for (Node< value_type >* node = first; node != last;)
+		{
+			Node< value_type >* next = block->next_active(node);
+			if (pred(std::as_const(*(block->value_of(node)))))
+			{
+				alloc_traits::destroy(alloc, block->value_of(node));
+				block->set_occupied(node, false);
+				erased++;
+				if (--block->block_size != 0)
+				{
+					push_free_node(block, node);
+				}
+			}
+			node = next;
+		}
+	} catch (...)
 	{
-		std::cerr << "Error not enough memory: " << n.what() << std::endl;
-		clear();
-		throw n;
+		settle();
+		throw;
 	}
+	settle();
+	return erased;
 }
 
-template< typename T >
-void BucketStorage< T >::copy(const BucketStorage& other)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename Pred >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::erase_matching(Pred& pred)
 {
-	try
+	size_type erased = 0;
+	for (block_type* block = head; block && block != tail;)
 	{
-		head = nullptr;
-		tail = new Block< value_type >();
-		current_size = other.current_size;
-		current_capacity = other.current_capacity;
-		block_capacity = other.block_capacity;
-		id_block = other.id_block;
-		id_node = other.id_node;
+		block_type* next = block->next;
+		erased += erase_nodes(block, block->first_active(), nullptr, pred);
+		block = next;
+	}
+	if (erased != 0 && current_size == 0)
+	{
+		clear();
+	}
+	return erased;
+}
 
-		if (other.head == nullptr)
-		{
-			return;
-		}
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::insert(value_type&& value)
+{
+	return insert_impl(nullptr, std::move(value));
+}
 
-		Block< value_type >* other_block = other.head;
-		auto* block = new Block< value_type >(other_block->block_id);
-		block->block_size = other_block->block_size;
-		head = block;
-		while (other_block)
-		{
-			Node< value_type >* other_node = other_block->b_head;
-			auto new_value_ptr = new value_type(*(other_node->value_ptr));
-			auto* node = new Node< value_type >(new_value_ptr, other_node->node_id, block);
-			block->b_head = node;
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::insert(const value_type& value)
+{
+	return insert_impl(nullptr, value);
+}
 
-			for (size_type i = 1; i < block->block_size; i++)
-			{
-				new_value_ptr = new value_type(*(other_node->next->value_ptr));
-				node->next = new Node< value_type >(new_value_ptr, other_node->next->node_id, block);
-				node->next->prev = node;
-				node = node->next;
-				other_node = other_node->next;
-			}
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< std::input_iterator InputIt >
+void BucketStorage< T, Allocator, Capacity, Inline >::insert(InputIt first, InputIt last)
+{
+	insert_bulk(std::move(first), std::move(last));
+}
 
-			block->b_tail = node;
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< std::ranges::input_range R >
+void BucketStorage< T, Allocator, Capacity, Inline >::insert_range(R&& range)
+{
+	insert_bulk(std::ranges::begin(range), std::ranges::end(range));
+}
 
-			if (other_block->next->next)
-			{
-				block->next = new Block< value_type >(other_block->next->block_id);
-				block->next->prev = block;
-				block->next->block_size = other_block->next->block_size;
-				block = block->next;
-				other_block = other_block->next;
-			}
-			else
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< std::input_iterator I, std::sentinel_for< I > S >
+void BucketStorage< T, Allocator, Capacity, Inline >::insert_bulk(I first, S last)
+{
+	std::vector< const_iterator, typename alloc_traits::template rebind_alloc< const_iterator > > filled(alloc);
+	block_type* appended = nullptr;
+	size_type appended_from = 0;
+	try
+	{
+		for (; first != last && !holes.empty(); ++first)
+		{
+			if (filled.size() == filled.capacity())
 			{
-				block->next = tail;
-				tail->prev = block;
-				other_block = other_block->next->next;
+				filled.reserve(2 * filled.size() + 1);
 			}
+			filled.push_back(insert_impl(nullptr, *first));
+		}
+		if constexpr (std::forward_iterator< I >)
+		{
+			reserve(current_size + static_cast< size_type >(std::ranges::distance(first, last)));
 		}
 
-		size_type other_ptr = other.deleted_blocks.ptr;
-		deleted_blocks.sz = other.deleted_blocks.sz;
-		deleted_blocks.elements = new Block< value_type >*[deleted_blocks.sz];
-		deleted_blocks.ptr = other_ptr;
-		while (other_ptr > 0)
+		while (first != last)
 		{
-			Block< value_type >* other_deleted_block = other.deleted_blocks.elements[--other_ptr];
-			auto* d_block = new Block< value_type >(other_deleted_block->block_id);
-			d_block->is_active = false;
-			if (other_deleted_block->prev)
+			block_type* block = get_position(nullptr).first;
+			if (!appended)
 			{
-				size_type d_block_id = other_deleted_block->prev->block_id;
-				if (other_deleted_block->prev->is_active)
-				{
-					Block< value_type >* current_block = head;
-					while (current_block)
-					{
-						if (current_block->block_id == d_block_id)
-						{
-							d_block->prev = current_block;
-							break;
-						}
-						current_block = current_block->next;
-					}
-				}
-				else
-				{
-					for (size_type i = deleted_blocks.ptr - 1; i > other_ptr; i--)
-					{
-						Block< value_type >* current_block = deleted_blocks.elements[i];
-						if (current_block->block_id == d_block_id)
-						{
-							d_block->prev = current_block;
-							break;
-						}
-					}
-				}
-			}
-			else
-			{
-				d_block->prev = nullptr;
+				appended = block;
+				appended_from = block->block_used;
 			}
-
-			size_type d_block_id = other_deleted_block->next->block_id;
-			if (other_deleted_block->next->is_active)
+			size_type count = 0;
+			try
 			{
-				Block< value_type >* current_block = head;
-				while (current_block)
+				for (; first != last && block->block_used < capacity_of(block); ++first)
 				{
-					if (current_block->block_id == d_block_id)
-					{
-						d_block->next = current_block;
-						break;
-					}
-					current_block = current_block->next;
+					Node< value_type >* node = block->nodes + block->block_used;
+					alloc_traits::construct(alloc, block->value_of(node), *first);
+					block->set_occupied(node, true);
+					node->node_id = ++id_node;
+					block->block_used++;
+					count++;
 				}
-			}
-			else
+			} catch (...)
 			{
-				if (other_deleted_block->next != other.tail)
+				block->block_size += count;
+				index_add(block, static_cast< difference_type >(count));
+				current_size += count;
+				if (block->block_size == 0)
 				{
-					for (size_type i = other.deleted_blocks.ptr - 1; i > other_ptr; i--)
+					if (appended == block)
 					{
-						Block< value_type >* current_block = deleted_blocks.elements[i];
-						if (current_block->block_id == d_block_id)
-						{
-							d_block->next = current_block;
-							break;
-						}
+						appended = nullptr;
 					}
+					release_block(block);
 				}
-				else
-				{
-					d_block->next = tail;
-				}
+				throw;
+			}
+			block->block_size += count;
+			index_add(block, static_cast< difference_type >(count));
+			current_size += count;
+		}
+	} catch (...)
+	{
+		if (appended && appended->block_used > appended_from)
+		{
+			erase(const_iterator(appended->nodes + appended_from, appended), cend());
+		}
+		for (auto it = filled.rbegin(); it != filled.rend(); ++it)
+		{
+			erase(*it);
+		}
+		throw;
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::reserve(size_type new_capacity)
+{
+	size_type available = current_capacity + (inline_block.used ? 0 : Inline);
+	for (block_type* spare = spare_head; spare; spare = spare->next)
+	{
+		available += capacity_of(spare);
+	}
+	size_type created = 0;
+	try
+	{
+		while (available < new_capacity)
+		{
+			block_type* block = create_block(next_block_id(), block_capacity);
+			claim_block_id();
+			block->is_active = false;
+			push_spare(block);
+			created++;
+			available += block_capacity;
+		}
+	} catch (...)
+	{
+		for (; created != 0; created--)
+		{
+			drop_spare();
+		}
+		throw;
+	}
+	if (index)
+	{
+		update_peak();
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename... Args >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::emplace(Args&&... args)
+{
+	return insert_impl(nullptr, std::forward< Args >(args)...);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename... Args >
+typename BucketStorage< T, Allocator, Capacity, Inline >::iterator
+	BucketStorage< T, Allocator, Capacity, Inline >::emplace_hint(const_iterator hint, Args&&... args)
+{
+	return insert_impl(hint.current_block, std::forward< Args >(args)...);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::copy(const BucketStorage& other)
+{
+	try
+	{
+		head = nullptr;
+		compact_cursor = nullptr;
+		current_size = other.current_size;
+		current_capacity = 0;
+		block_capacity = other.block_capacity;
+		id_block = other.id_block;
+		id_node = other.id_node;
+		retention = other.retention;
+		if (id_block > 1)
+		{
+			free_ids.reserve(id_block);
+		}
+		free_ids.assign(other.free_ids.begin(), other.free_ids.end());
+
+		std::vector< block_type*, typename alloc_traits::template rebind_alloc< block_type* > >
+			copied_blocks(other.index ? other.index->blocks.size() : 0, nullptr, alloc);
+		auto copied = [&](const block_type* other_block)
+		{ return other.index ? copied_blocks[other_block->ordinal] : head; };
+		for (block_type* other_block = other.head; other_block && other_block != other.tail;
+			 other_block = other_block->next)
+		{
+			block_type* block = other.inline_block.holds(other_block)
+									? inline_block.create(other_block->block_id)
+									: create_block(other_block->block_id, other_block->block_capacity);
+			link_block(block);
+			if (other.index)
+			{
+				copied_blocks[other_block->ordinal] = block;
 			}
-			deleted_blocks.elements[other_ptr] = d_block;
-		}
-		other_ptr = other.deleted_nodes.ptr;
-		deleted_nodes.sz = other.deleted_nodes.sz;
-		deleted_nodes.elements = new Node< value_type >*[deleted_nodes.sz];
-		deleted_nodes.ptr = other_ptr;
-		while (other_ptr > 0)
-		{
-			auto* d_node = new Node< value_type >();
-			Node< value_type >* other_deleted_node = other.deleted_nodes.elements[--other_ptr];
-			size_type d_block_id = other_deleted_node->block->block_id;
-			Block< value_type >* block_for_node = nullptr;
-			d_node->node_id = other_deleted_node->node_id;
-			bool active = other_deleted_node->block->is_active;
-			if (active)
+			if constexpr (std::is_trivially_copyable_v< value_type >)
 			{
-				Block< value_type >* current_block = head;
-				while (current_block)
+				std::memcpy(block->occupancy,
+							other_block->occupancy,
+							block_type::mask_words(other_block->block_used) *
+								sizeof(typename block_type::mask_type));
+				std::memcpy(static_cast< void* >(block->slots),
+							other_block->slots,
+							other_block->block_used * sizeof(value_type));
+				for (size_type i = 0; i < other_block->block_used; i++)
 				{
-					if (current_block->block_id == d_block_id)
-					{
-						block_for_node = current_block;
-						break;
-					}
-					current_block = current_block->next;
+					block->nodes[i].node_id = other_block->nodes[i].node_id;
 				}
+				block->block_used = other_block->block_used;
+				block->block_size = other_block->block_size;
 			}
 			else
 			{
-				for (size_type i = 0; i < deleted_blocks.ptr; i++)
+				for (size_type i = 0; i < other_block->block_used; i++)
 				{
-					Block< value_type >* current_block = deleted_blocks.elements[i];
-					if (current_block->block_id == d_block_id)
+					Node< value_type >* other_node = other_block->nodes + i;
+					Node< value_type >* node = block->nodes + i;
+					if (other_block->is_occupied(other_node))
 					{
-						block_for_node = current_block;
-						break;
+						alloc_traits::construct(alloc, block->value_of(node), *(other_block->value_of(other_node)));
+						block->set_occupied(node, true);
+						block->block_size++;
 					}
+					node->node_id = other_node->node_id;
+					block->block_used++;
 				}
 			}
-			d_node->block = block_for_node;
+			index_add(block, static_cast< difference_type >(block->block_size));
 
-			if (other_deleted_node->prev)
+			Node< value_type >** link = &block->free_head;
+			for (Node< value_type >* other_node = other_block->free_head; other_node;
+				 other_node = other_node->next_free)
 			{
-				size_type d_node_id = other_deleted_node->prev->node_id;
-				if (other_deleted_node->prev->is_active)
-				{
-					Node< value_type >* current_node = block_for_node->b_head;
-					while (current_node)
-					{
-						if (current_node->node_id == d_node_id)
-						{
-							d_node->prev = current_node;
-							break;
-						}
-						current_node = current_node->next;
-					}
-				}
-				else
-				{
-					for (size_type i = deleted_nodes.ptr - 1; i > other_ptr; i--)
-					{
-						Node< value_type >* current_node = deleted_nodes.elements[i];
-						if (current_node->node_id == d_node_id)
-						{
-							d_node->prev = current_node;
-							break;
-						}
-					}
-				}
+				*link = block->nodes + (other_node - other_block->nodes);
+				link = &(*link)->next_free;
 			}
-			else
+			*link = nullptr;
+		}
+
+		for (block_type* other_spare = other.spare_head; other_spare; other_spare = other_spare->next)
+		{
+			block_type* spare = other.inline_block.holds(other_spare)
+									? inline_block.create(other_spare->block_id)
+									: create_block(other_spare->block_id, other_spare->block_capacity);
+			spare->is_active = false;
+			push_spare(spare);
+		}
+		update_peak();
+
+		holes.policy = other.holes.policy;
+		holes.reserve(linked_blocks());
+		if (holes.policy == ReusePolicy::lowest_address)
+		{
+			for (block_type* other_block : other.holes.heap)
 			{
-				d_node->prev = nullptr;
+				holes.add(copied(other_block));
 			}
-
-			if (other_deleted_node->next)
+		}
+		else
+		{
+			for (block_type* other_block : other.holes.lists)
 			{
-				size_type d_node_id = other_deleted_node->next->node_id;
-				if (other_deleted_node->next->is_active)
+				while (other_block && other_block->hole_next)
 				{
-					Node< value_type >* current_node = block_for_node->b_head;
-					while (current_node)
-					{
-						if (current_node->node_id == d_node_id)
-						{
-							d_node->next = current_node;
-							break;
-						}
-						current_node = current_node->next;
-					}
+					other_block = other_block->hole_next;
 				}
-				else
+				for (; other_block; other_block = other_block->hole_prev)
 				{
-					for (size_type i = deleted_nodes.ptr - 1; i > other_ptr; i--)
-					{
-						Node< value_type >* current_node = deleted_nodes.elements[i];
-						if (current_node->node_id == d_node_id)
-						{
-							d_node->next = current_node;
-							break;
-						}
-					}
+					holes.add(copied(other_block));
 				}
 			}
-			else
-			{
-				d_node->next = nullptr;
-			}
-			deleted_nodes.elements[other_ptr] = d_node;
 		}
-	} catch (std::bad_alloc& n)
+		if (other.preferred)
+		{
+			preferred = copied(other.preferred);
+		}
+	} catch (...)
 	{
-		std::cerr << "Error not enough memory: " << n.what() << std::endl;
 		clear();
-		throw n;
+		throw;
 	}
 }
 
-template< typename T >
-void BucketStorage< T >::clear()
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+Block< T, Capacity >* BucketStorage< T, Allocator, Capacity, Inline >::create_block(size_type id, size_type capacity)
+{
+	block_allocator b_alloc(alloc);
+	chunk_allocator c_alloc(alloc);
+	block_type* block = block_traits::allocate(b_alloc, 1);
+	chunk_type* buffer;
+	try
+	{
+		buffer = chunk_traits::allocate(c_alloc, block_type::storage_chunks(capacity));
+	} catch (...)
+	{
+		block_traits::deallocate(b_alloc, block, 1);
+		throw;
+	}
+#ifdef BUCKET_STORAGE_ENABLE_STATS
+	blocks_allocated++;
+#endif
+	return ::new (static_cast< void* >(block)) block_type(id, capacity, buffer);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::destroy_block(block_type* block) noexcept
+{
+	if constexpr (Inline > 0)
+	{
+		if (inline_block.holds(block))
+		{
+			block->destroy_values(alloc);
+			block->~Block();
+			inline_block.used = false;
+			return;
+		}
+	}
+#ifdef BUCKET_STORAGE_ENABLE_STATS
+	blocks_freed += block->storage ? 1 : 0;
+#endif
+	block->destroy_values(alloc);
+	if (block->storage && (reinterpret_cast< unsigned char* >(block->storage) < snapshot ||
+						   reinterpret_cast< unsigned char* >(block->storage) >= snapshot + snapshot_size))
+	{
+		chunk_allocator c_alloc(alloc);
+		chunk_traits::deallocate(c_alloc, block->storage, block_type::storage_chunks(capacity_of(block)));
+	}
+	block->~Block();
+	block_allocator b_alloc(alloc);
+	block_traits::deallocate(b_alloc, block, 1);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::drop_spare() noexcept
+{
+	block_type* block = pop_spare();
+	if (block->block_id == id_block)
+	{
+		id_block--;
+	}
+	else
+	{
+		free_ids.push_back(block->block_id);
+	}
+	destroy_block(block);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	BucketStorage< T, Allocator, Capacity, Inline >::next_block_id()
+{
+	if (!free_ids.empty())
+	{
+		return free_ids.back();
+	}
+	if (id_block != 0 && free_ids.capacity() <= id_block)
+	{
+		free_ids.reserve(std::max(id_block + 1, 2 * free_ids.capacity()));
+	}
+	return id_block + 1;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::claim_block_id() noexcept
+{
+	if (free_ids.empty())
+	{
+		id_block++;
+	}
+	else
+	{
+		free_ids.pop_back();
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::reclaim_block_ids()
+{
+	id_block = 0;
+	for (block_type* block = head; block && block != tail; block = block->next)
+	{
+		id_block = std::max(id_block, block->block_id);
+	}
+	std::vector< bool, typename alloc_traits::template rebind_alloc< bool > > taken(id_block, false, alloc);
+	for (block_type* block = head; block && block != tail; block = block->next)
+	{
+		if (taken[block->block_id - 1])
+		{
+			throw std::runtime_error("BucketStorage: duplicate block id");
+		}
+		taken[block->block_id - 1] = true;
+	}
+	free_ids.clear();
+	free_ids.reserve(id_block);
+	for (size_type id = id_block; id > 0; id--)
+	{
+		if (!taken[id - 1])
+		{
+			free_ids.push_back(id);
+		}
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::create_index()
+{
+	index_allocator i_alloc(alloc);
+	index_type* created = index_traits::allocate(i_alloc, 1);
+	::new (static_cast< void* >(created)) index_type(tail, alloc);
+	if (head)
+	{
+		try
+		{
+			created->push_back(head);
+		} catch (...)
+		{
+			created->~index_type();
+			index_traits::deallocate(i_alloc, created, 1);
+			throw;
+		}
+		head->index = created;
+	}
+	index = created;
+	tail->index = index;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::destroy_index() noexcept
+{
+	if (index)
+	{
+		index_allocator i_alloc(alloc);
+		index->~index_type();
+		index_traits::deallocate(i_alloc, index, 1);
+	}
+	index = nullptr;
+	tail->index = nullptr;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::attach_sentinel() noexcept
+{
+	if (tail->prev)
+	{
+		tail->prev->next = tail;
+	}
+	tail->index = index;
+	if (index)
+	{
+		index->sentinel = tail;
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::adopt_inline(BucketStorage& other) noexcept
+{
+	if (inline_block.used || !other.inline_block.used)
+	{
+		return;
+	}
+	block_type* from = other.inline_block.get();
+	block_type* block = inline_block.create(from->block_id);
+	block->next = from->next;
+	block->prev = from->prev;
+	block->index = from->index;
+	block->hole_prev = from->hole_prev;
+	block->hole_next = from->hole_next;
+	block->hole_slot = from->hole_slot;
+	block->block_used = from->block_used;
+	block->block_size = from->block_size;
+	block->ordinal = from->ordinal;
+	block->is_active = from->is_active;
+	std::copy(from->occupancy, from->occupancy + block_type::mask_words(Inline), block->occupancy);
+	block->free_head = from->free_head ? block->nodes + (from->free_head - from->nodes) : nullptr;
+	for (size_type i = 0; i < from->block_used; i++)
+	{
+		Node< value_type >* node = block->nodes + i;
+		Node< value_type >* other_node = from->nodes + i;
+		if (from->is_occupied(other_node))
+		{
+			node->node_id = other_node->node_id;
+			alloc_traits::construct(alloc, block->value_of(node), std::move(*(from->value_of(other_node))));
+			alloc_traits::destroy(other.alloc, from->value_of(other_node));
+		}
+		else
+		{
+			node->next_free = other_node->next_free ? block->nodes + (other_node->next_free - from->nodes) : nullptr;
+		}
+	}
+
+	if (block->is_active)
+	{
+		if (block->prev)
+		{
+			block->prev->next = block;
+		}
+		else
+		{
+			head = block;
+		}
+		block->next->prev = block;
+		if (index)
+		{
+			index->blocks[block->ordinal] = block;
+			index->by_id[block->block_id - 1] = block;
+		}
+		if (block->free_head)
+		{
+			holes.relink(block);
+		}
+		if (preferred == from)
+		{
+			preferred = block;
+		}
+		if (compact_cursor == from)
+		{
+			compact_cursor = block;
+		}
+	}
+	else
+	{
+		block_type** link = &spare_head;
+		while (*link != from)
+		{
+			link = &(*link)->next;
+		}
+		*link = block;
+	}
+	from->~Block();
+	other.inline_block.used = false;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::destroy_blocks() noexcept
 {
 	while (head)
 	{
-		Block< value_type >* b_next = head->next;
-		delete head;
+		block_type* b_next = head->next == tail ? nullptr : head->next;
+		destroy_block(head);
 		head = b_next;
 	}
-	head = nullptr;
+	while (spare_count != 0)
+	{
+		destroy_block(pop_spare());
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::clear()
+{
+	destroy_blocks();
+	release_snapshot();
 
+	current_size = 0;
+	current_capacity = 0;
+	id_block = 0;
+	free_ids.clear();
+	holes.clear();
+	preferred = nullptr;
+	compact_cursor = nullptr;
+	peak_blocks = 0;
+	tail->prev = nullptr;
+	if (index)
+	{
+		index->clear();
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::release_all() noexcept
+{
+	destroy_blocks();
+	release_snapshot();
+	destroy_index();
+	tail->prev = nullptr;
+	holes.clear();
+	preferred = nullptr;
+	compact_cursor = nullptr;
+	peak_blocks = 0;
 	current_size = 0;
 	current_capacity = 0;
 	id_node = 0;
 	id_block = 0;
-	deleted_blocks.clear();
-	deleted_nodes.clear();
-	tail = new Block< value_type >();
+	free_ids.clear();
 }
 
-template< typename T >
-BucketStorage< T >& BucketStorage< T >::operator=(BucketStorage&& other) noexcept
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >&
+	BucketStorage< T, Allocator, Capacity, Inline >::operator=(BucketStorage&& other) noexcept(
+		std::allocator_traits< Allocator >::propagate_on_container_move_assignment::value ||
+		std::allocator_traits< Allocator >::is_always_equal::value)
 {
 	if (this != &other)
 	{
-		clear();
+		if constexpr (!alloc_traits::propagate_on_container_move_assignment::value &&
+					  !alloc_traits::is_always_equal::value)
+		{
+			if (alloc != other.alloc)
+			{
+				clear();
+				block_capacity = other.block_capacity;
+				retention = other.retention;
+				move_elements(std::move(other));
+				return *this;
+			}
+		}
+		release_all();
+		if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+		{
+			alloc = other.alloc;
+		}
 		move(std::move(other));
 	}
 	return *this;
 }
 
-template< typename T >
-BucketStorage< T >& BucketStorage< T >::operator=(const BucketStorage& other)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >&
+	BucketStorage< T, Allocator, Capacity, Inline >::operator=(const BucketStorage& other)
 {
 	if (this != &other)
 	{
+		if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (alloc != other.alloc)
+			{
+				release_all();
+				holes.~HoleIndex();
+				free_ids.~id_list();
+				alloc = other.alloc;
+				::new (static_cast< void* >(&free_ids)) id_list(alloc);
+				::new (static_cast< void* >(&holes)) HoleIndex< value_type, allocator_type, Capacity >(alloc);
+			}
+		}
 		clear();
 		copy(other);
 	}
 	return *this;
 }
 
-template< typename T >
-BucketStorage< T >::BucketStorage(const BucketStorage& other)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >::BucketStorage(const BucketStorage& other) :
+	BucketStorage(other, alloc_traits::select_on_container_copy_construction(other.alloc))
+{
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >::BucketStorage(
+	const BucketStorage& other,
+	const allocator_type& allocator) :
+	BucketStorage(other.block_capacity, allocator)
 {
-	tail = new Block< value_type >();
-	current_size = other.current_size;
-	block_capacity = other.block_capacity;
-	current_capacity = other.current_capacity;
-	id_block = 0;
-	id_node = 0;
-	head = nullptr;
 	copy(other);
 }
 
-template< typename T >
-void BucketStorage< T >::move(BucketStorage&& other) noexcept
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::move(BucketStorage&& other) noexcept
 {
 	head = std::exchange(other.head, nullptr);
-	tail = std::exchange(other.tail, nullptr);
+	tail->prev = std::exchange(other.tail->prev, nullptr);
+	index = std::exchange(other.index, nullptr);
+	other.tail->index = nullptr;
+	attach_sentinel();
 	current_size = std::exchange(other.current_size, 0);
-	block_capacity = std::exchange(other.block_capacity, 0);
-	id_node = std::exchange(other.id_node, 0);
+	block_capacity = other.block_capacity;
+	id_node = other.id_node;
 	id_block = std::exchange(other.id_block, 0);
+	free_ids.swap(other.free_ids);
+	other.free_ids.clear();
 	current_capacity = std::exchange(other.current_capacity, 0);
-	deleted_blocks = std::move(other.deleted_blocks);
-	deleted_nodes = std::move(other.deleted_nodes);
+	snapshot = std::exchange(other.snapshot, nullptr);
+	snapshot_size = std::exchange(other.snapshot_size, 0);
+#ifdef BUCKET_STORAGE_ENABLE_STATS
+	blocks_allocated = std::exchange(other.blocks_allocated, 0);
+	blocks_freed = std::exchange(other.blocks_freed, 0);
+#endif
+	spare_head = std::exchange(other.spare_head, nullptr);
+	spare_count = std::exchange(other.spare_count, 0);
+	holes.swap(other.holes);
+	other.holes.clear();
+	preferred = std::exchange(other.preferred, nullptr);
+	compact_cursor = std::exchange(other.compact_cursor, nullptr);
+	retention = other.retention;
+	peak_blocks = std::exchange(other.peak_blocks, 0);
+	if constexpr (Inline > 0)
+	{
+		adopt_inline(other);
+	}
 }
 
-template< typename T >
-BucketStorage< T >::BucketStorage(BucketStorage&& other) noexcept
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::move_elements(BucketStorage&& other)
+{
+	reserve(other.current_size);
+	for (value_type& value : other)
+	{
+		insert_impl(nullptr, std::move(value));
+	}
+	other.clear();
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >::BucketStorage(BucketStorage&& other) noexcept :
+	alloc(other.alloc), current_size(0), block_capacity(other.block_capacity), current_capacity(0), id_node(0),
+	id_block(0), free_ids(alloc), holes(alloc), spare_head(nullptr), spare_count(0), head(nullptr), tail(&sentinel),
+	index(nullptr), preferred(nullptr), compact_cursor(nullptr), retention(other.retention), peak_blocks(0),
+	snapshot(nullptr), snapshot_size(0)
 {
-	current_size = 0;
-	block_capacity = 0;
-	id_block = 0;
-	id_node = 0;
-	current_capacity = 0;
 	move(std::move(other));
 }
 
-template< typename T >
-BucketStorage< T >::~BucketStorage()
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >::BucketStorage(BucketStorage&& other, const allocator_type& allocator) :
+	alloc(allocator), current_size(0), block_capacity(other.block_capacity), current_capacity(0), id_node(0),
+	id_block(0), free_ids(alloc), holes(alloc), spare_head(nullptr), spare_count(0), head(nullptr), tail(&sentinel),
+	index(nullptr), preferred(nullptr), compact_cursor(nullptr), retention(other.retention), peak_blocks(0),
+	snapshot(nullptr), snapshot_size(0)
 {
-	clear();
-	delete tail;
+	if (alloc == other.alloc)
+	{
+		move(std::move(other));
+		return;
+	}
+
+	try
+	{
+		move_elements(std::move(other));
+	} catch (...)
+	{
+		release_all();
+		throw;
+	}
 }
 
-template< typename T >
-BucketStorage< T >::BucketStorage(size_type capacity)
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >::~BucketStorage()
 {
-	tail = new Block< value_type >();
-	id_block = 0;
-	id_node = 0;
-	current_size = 0;
-	block_capacity = capacity;
-	head = nullptr;
-	current_capacity = 0;
+	release_all();
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >::BucketStorage(size_type capacity, const allocator_type& allocator) :
+	alloc(allocator), current_size(0), block_capacity(capacity), current_capacity(0), id_node(0), id_block(0),
+	free_ids(alloc), holes(alloc), spare_head(nullptr), spare_count(0), head(nullptr), tail(&sentinel), index(nullptr),
+	preferred(nullptr), compact_cursor(nullptr), retention(), peak_blocks(0), snapshot(nullptr), snapshot_size(0)
+{
+	if (fixed_capacity && capacity != Capacity)
+	{
+		throw std::invalid_argument("BucketStorage: block capacity is fixed at compile time");
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >::BucketStorage(const allocator_type& allocator) :
+	BucketStorage(default_block_capacity, allocator)
+{
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::release_snapshot() noexcept
+{
+#ifdef CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP
+	if (snapshot)
+	{
+		::munmap(snapshot, snapshot_size);
+	}
+#endif
+	snapshot = nullptr;
+	snapshot_size = 0;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::check_snapshot(const SnapshotHeader& header, size_type file_size)
+{
+	if (!std::equal(std::begin(snapshot_magic), std::end(snapshot_magic), header.magic) ||
+		header.version != snapshot_version)
+	{
+		throw std::runtime_error("BucketStorage: unsupported snapshot format");
+	}
+	if (header.value_size != sizeof(value_type) || header.value_alignment != alignof(value_type) ||
+		header.node_size != sizeof(Node< value_type >))
+	{
+		throw std::runtime_error("BucketStorage: snapshot layout does not match the element type");
+	}
+	if (header.block_count > (file_size - sizeof(SnapshotHeader)) / sizeof(SnapshotBlock))
+	{
+		throw std::runtime_error("BucketStorage: truncated snapshot");
+	}
+	if (fixed_capacity && header.block_capacity != Capacity)
+	{
+		throw std::runtime_error("BucketStorage: snapshot block capacity does not match");
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::check_snapshot(
+	const SnapshotBlock& entry,
+	size_type id_block,
+	size_type file_size)
+{
+	if (entry.block_id == 0 || entry.block_id > id_block || entry.block_capacity == 0 ||
+		(fixed_capacity && entry.block_capacity != Capacity) || entry.block_size == 0 ||
+		entry.block_size > entry.block_used || entry.block_used > entry.block_capacity ||
+		entry.offset % sizeof(chunk_type) != 0 || entry.block_capacity > file_size ||
+		entry.offset + block_type::storage_chunks(entry.block_capacity) * sizeof(chunk_type) > file_size)
+	{
+		throw std::runtime_error("BucketStorage: corrupt snapshot block");
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::restore_block(const SnapshotBlock& entry, chunk_type* buffer)
+{
+	block_allocator b_alloc(alloc);
+	block_type* block = ::new (static_cast< void* >(block_traits::allocate(b_alloc, 1)))
+		block_type(entry.block_id, entry.block_capacity, buffer, entry.block_used, entry.block_size);
+#ifdef BUCKET_STORAGE_ENABLE_STATS
+	blocks_allocated++;
+#endif
+	link_block(block);
+
+	size_type live = 0;
+	for (size_type word = 0; word < block_type::mask_words(block->block_capacity); word++)
+	{
+		live += std::popcount(block->occupancy[word]);
+	}
+	if (live != block->block_size || !block->is_occupied(block->last_active()))
+	{
+		throw std::runtime_error("BucketStorage: corrupt snapshot block");
+	}
+	for (Node< value_type >* node = block->first_free(); node; node = block->find_set(node - block->nodes + 1, false))
+	{
+		push_free_node(block, node);
+	}
+	current_size += block->block_size;
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+void BucketStorage< T, Allocator, Capacity, Inline >::save(const std::string& path) const
+	requires std::is_trivially_copyable_v< T >
+{
+	SnapshotHeader header{};
+	std::copy(std::begin(snapshot_magic), std::end(snapshot_magic), header.magic);
+	header.version = snapshot_version;
+	header.value_size = sizeof(value_type);
+	header.value_alignment = alignof(value_type);
+	header.node_size = sizeof(Node< value_type >);
+	header.block_capacity = block_capacity;
+	header.size = current_size;
+	header.id_node = id_node;
+	header.id_block = id_block;
+
+	std::vector< SnapshotBlock > entries;
+	for (block_type* block = head; block && block != tail; block = block->next)
+	{
+		entries.push_back({ block->block_id, block->block_capacity, block->block_used, block->block_size, 0 });
+	}
+	header.block_count = entries.size();
+	size_type offset = sizeof(SnapshotHeader) + entries.size() * sizeof(SnapshotBlock);
+	for (SnapshotBlock& entry : entries)
+	{
+		entry.offset = (offset + sizeof(chunk_type) - 1) / sizeof(chunk_type) * sizeof(chunk_type);
+		offset = entry.offset + block_type::storage_chunks(entry.block_capacity) * sizeof(chunk_type);
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		throw std::system_error(errno, std::generic_category(), path);
+	}
+	static const char zeros[4096] = {};
+	size_type position = 0;
+	auto pad = [&out, &position](size_type to)
+	{
+		for (; position < to; position += std::min(to - position, sizeof(zeros)))
+		{
+			out.write(zeros, static_cast< std::streamsize >(std::min(to - position, sizeof(zeros))));
+		}
+	};
+
+	out.write(reinterpret_cast< const char* >(&header), sizeof(SnapshotHeader));
+	out.write(reinterpret_cast< const char* >(entries.data()),
+			  static_cast< std::streamsize >(entries.size() * sizeof(SnapshotBlock)));
+	position = sizeof(SnapshotHeader) + entries.size() * sizeof(SnapshotBlock);
+	block_type* block = head;
+	for (const SnapshotBlock& entry : entries)
+	{
+		pad(entry.offset);
+		size_type bytes =
+			block_type::slots_offset(block->block_capacity) + block->block_used * sizeof(value_type);
+		out.write(reinterpret_cast< const char* >(block->storage), static_cast< std::streamsize >(bytes));
+		position += bytes;
+		pad(entry.offset + block_type::storage_chunks(entry.block_capacity) * sizeof(chunk_type));
+		block = block->next;
+	}
+	out.flush();
+	if (!out)
+	{
+		throw std::system_error(errno, std::generic_category(), path);
+	}
+}
+
+#ifdef CT_C24_LW_CONTAINERS_NUDA9A_HAS_MMAP
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+BucketStorage< T, Allocator, Capacity, Inline >
+	BucketStorage< T, Allocator, Capacity, Inline >::map(const std::string& path, const allocator_type& allocator)
+	requires std::is_trivially_copyable_v< T >
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::system_error(errno, std::generic_category(), path);
+	}
+	struct stat info
+	{
+	};
+	if (::fstat(fd, &info) != 0)
+	{
+		int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), path);
+	}
+	auto file_size = static_cast< size_type >(info.st_size);
+	if (file_size < sizeof(SnapshotHeader))
+	{
+		::close(fd);
+		throw std::runtime_error("BucketStorage: truncated snapshot");
+	}
+	void* data = ::mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	int error = errno;
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		throw std::system_error(error, std::generic_category(), path);
+	}
+
+	BucketStorage result(default_block_capacity, allocator);
+	result.snapshot = static_cast< unsigned char* >(data);
+	result.snapshot_size = file_size;
+	const auto* header = reinterpret_cast< const SnapshotHeader* >(result.snapshot);
+	check_snapshot(*header, file_size);
+	const auto* entries = reinterpret_cast< const SnapshotBlock* >(result.snapshot + sizeof(SnapshotHeader));
+	for (size_type i = 0; i < header->block_count; i++)
+	{
+		check_snapshot(entries[i], header->id_block, file_size);
+		result.restore_block(entries[i], reinterpret_cast< chunk_type* >(result.snapshot + entries[i].offset));
+	}
+	if (result.current_size != header->size)
+	{
+		throw std::runtime_error("BucketStorage: corrupt snapshot");
+	}
+	result.block_capacity = header->block_capacity;
+	result.id_node = header->id_node;
+	result.reclaim_block_ids();
+	return result;
+}
+#endif
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename Codec >
+void BucketStorage< T, Allocator, Capacity, Inline >::serialize(std::ostream& out, Codec codec) const
+{
+	SnapshotHeader header{};
+	std::copy(std::begin(stream_magic), std::end(stream_magic), header.magic);
+	header.version = snapshot_version;
+	header.value_size = sizeof(value_type);
+	header.value_alignment = alignof(value_type);
+	header.node_size = sizeof(Node< value_type >);
+	header.block_capacity = block_capacity;
+	header.size = current_size;
+	header.id_node = id_node;
+	header.id_block = id_block;
+	header.block_count = linked_blocks();
+	out.write(reinterpret_cast< const char* >(&header), sizeof(SnapshotHeader));
+
+	std::vector< std::uint64_t > node_ids;
+	for (block_type* block = head; block && block != tail; block = block->next)
+	{
+		SnapshotBlock entry{ block->block_id, block->block_capacity, block->block_used, block->block_size, 0 };
+		out.write(reinterpret_cast< const char* >(&entry), sizeof(SnapshotBlock));
+		out.write(reinterpret_cast< const char* >(block->occupancy),
+				  static_cast< std::streamsize >(block_type::mask_words(block->block_used) *
+												 sizeof(typename block_type::mask_type)));
+		node_ids.resize(block->block_used);
+		for (size_type i = 0; i < block->block_used; i++)
+		{
+			node_ids[i] = block->is_occupied(block->nodes + i) ? block->nodes[i].node_id : 0;
+		}
+		out.write(reinterpret_cast< const char* >(node_ids.data()),
+				  static_cast< std::streamsize >(node_ids.size() * sizeof(std::uint64_t)));
+		for (Node< value_type >* node = block->first_active(); node; node = block->next_active(node))
+		{
+			codec.encode(out, *(block->value_of(node)));
+		}
+	}
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+template< typename Codec >
+void BucketStorage< T, Allocator, Capacity, Inline >::deserialize(std::istream& in, Codec codec)
+{
+	SnapshotHeader header{};
+	if (!in.read(reinterpret_cast< char* >(&header), sizeof(SnapshotHeader)) ||
+		!std::equal(std::begin(stream_magic), std::end(stream_magic), header.magic) ||
+		header.version != snapshot_version)
+	{
+		throw std::runtime_error("BucketStorage: unsupported stream format");
+	}
+	if (fixed_capacity && header.block_capacity != Capacity)
+	{
+		throw std::runtime_error("BucketStorage: stream block capacity does not match");
+	}
+	if (header.block_capacity == 0 ||
+		header.block_capacity > std::numeric_limits< size_type >::max() /
+									(2 * (sizeof(value_type) + sizeof(Node< value_type >) + 1)))
+	{
+		throw std::runtime_error("BucketStorage: corrupt stream");
+	}
+
+	BucketStorage result(header.block_capacity, alloc);
+	result.holes.policy = holes.policy;
+	result.retention = retention;
+	auto read_array = [&in](auto& values, size_type count)
+	{
+		values.clear();
+		while (values.size() < count)
+		{
+			size_type offset = values.size();
+			values.resize(offset + std::min< size_type >(count - offset, stream_chunk));
+			if (!in.read(reinterpret_cast< char* >(values.data() + offset),
+						 static_cast< std::streamsize >((values.size() - offset) * sizeof(values[0]))))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	block_type* block = nullptr;
+	try
+	{
+		std::vector< typename block_type::mask_type > occupancy;
+		std::vector< std::uint64_t > node_ids;
+		for (size_type next = 0; next < header.block_count; next++)
+		{
+			SnapshotBlock entry{};
+			if (!in.read(reinterpret_cast< char* >(&entry), sizeof(SnapshotBlock)) ||
+				entry.block_id == 0 || entry.block_id > header.id_block ||
+				(entry.block_capacity != result.block_capacity && (Inline == 0 || entry.block_capacity != Inline)) ||
+				entry.block_size == 0 || entry.block_size > entry.block_used || entry.block_used > entry.block_capacity)
+			{
+				throw std::runtime_error("BucketStorage: corrupt stream block");
+			}
+			if (!read_array(occupancy, block_type::mask_words(entry.block_used)) ||
+				!read_array(node_ids, entry.block_used))
+			{
+				throw std::runtime_error("BucketStorage: truncated stream");
+			}
+
+			if (entry.block_capacity == result.block_capacity)
+			{
+				block = result.create_block(0, result.block_capacity);
+			}
+			else
+			{
+				block = result.inline_block.used ? result.create_block(0, Inline) : result.inline_block.create(0);
+			}
+			block->block_id = entry.block_id;
+			block->block_used = entry.block_used;
+			for (size_type i = 0; i < entry.block_used; i++)
+			{
+				Node< value_type >* node = block->nodes + i;
+				node->node_id = node_ids[i];
+				if ((occupancy[i / block_type::mask_bits] >> (i % block_type::mask_bits)) & 1)
+				{
+					alloc_traits::construct(result.alloc, block->value_of(node), codec.decode(in));
+					block->set_occupied(node, true);
+					block->block_size++;
+				}
+			}
+			if (block->block_size != entry.block_size)
+			{
+				throw std::runtime_error("BucketStorage: corrupt stream block");
+			}
+
+			result.link_block(block);
+			block_type* linked = std::exchange(block, nullptr);
+			for (Node< value_type >* node = linked->first_free(); node;
+				 node = linked->find_set(node - linked->nodes + 1, false))
+			{
+				result.push_free_node(linked, node);
+			}
+			result.current_size += linked->block_size;
+		}
+		if (result.current_size != header.size)
+		{
+			throw std::runtime_error("BucketStorage: corrupt stream");
+		}
+		result.reclaim_block_ids();
+	} catch (...)
+	{
+		if (block)
+		{
+			result.destroy_block(block);
+		}
+		throw;
+	}
+	result.id_node = header.id_node;
+	swap(result);
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::block_range
+	BucketStorage< T, Allocator, Capacity, Inline >::blocks() noexcept
+{
+	using block_iterator = BlockIterator< false, value_type, Capacity >;
+	return block_range(block_iterator(head ? head : tail), block_iterator(tail));
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
+typename BucketStorage< T, Allocator, Capacity, Inline >::const_block_range
+	BucketStorage< T, Allocator, Capacity, Inline >::blocks() const noexcept
+{
+	using block_iterator = BlockIterator< true, value_type, Capacity >;
+	return const_block_range(block_iterator(head ? head : tail), block_iterator(tail));
+}
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline, typename Pred >
+typename BucketStorage< T, Allocator, Capacity, Inline >::size_type
+	erase_if(BucketStorage< T, Allocator, Capacity, Inline >& storage, Pred pred)
+{
+	return storage.erase_matching(pred);
 }
 
 #endif	  // CT_C24_LW_CONTAINERS_NUDA9A_BUCKET_STORAGE_HPP
@@ -0,0 +1,375 @@
+#include "helpers.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+template< std::size_t N >
+class Payload
+{
+  public:
+	std::array< unsigned char, N > bytes;
+	explicit Payload(std::size_t seed) noexcept { bytes.fill(static_cast< unsigned char >(seed)); }
+};
+
+template< std::size_t N >
+std::size_t value_of(const Payload< N >& value)
+{
+	return value.bytes[0];
+}
+
+std::size_t value_of(const CountedOperationObject& value)
+{
+	return value.number;
+}
+
+template< typename C >
+struct is_bucket_storage : std::false_type
+{
+};
+
+template< typename T, typename A, std::size_t N, std::size_t M >
+struct is_bucket_storage< BucketStorage< T, A, N, M > > : std::true_type
+{
+};
+
+template< typename C >
+constexpr bool has_stable_iterators =
+	is_bucket_storage< C >::value || std::is_same_v< C, std::list< typename C::value_type > >;
+
+template< typename C >
+C make(const benchmark::State& state)
+{
+	if constexpr (is_bucket_storage< C >::value)
+	{
+		if constexpr (C::fixed_capacity)
+		{
+			return C();
+		}
+		else
+		{
+			return C(static_cast< std::size_t >(state.range(1)));
+		}
+	}
+	else
+	{
+		return C();
+	}
+}
+
+template< typename C >
+void fill(C& container, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+	{
+		container.insert(container.end(), typename C::value_type(i));
+	}
+}
+
+template< typename T, typename A, std::size_t N, std::size_t M >
+void fill(BucketStorage< T, A, N, M >& container, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+	{
+		container.insert(T(i));
+	}
+}
+
+template< typename C >
+void erase_random(C& container, std::size_t count, std::mt19937_64& rng)
+{
+	if constexpr (has_stable_iterators< C >)
+	{
+		std::vector< typename C::iterator > positions;
+		positions.reserve(container.size());
+		for (auto it = container.begin(); it != container.end(); ++it)
+		{
+			positions.push_back(it);
+		}
+		std::shuffle(positions.begin(), positions.end(), rng);
+		for (std::size_t i = 0; i < count && i < positions.size(); i++)
+		{
+			container.erase(positions[i]);
+		}
+	}
+	else
+	{
+		for (std::size_t i = 0; i < count && !container.empty(); i++)
+		{
+			container.erase(container.begin() + static_cast< std::ptrdiff_t >(rng() % container.size()));
+		}
+	}
+}
+
+template< typename C >
+std::size_t checksum(const C& container)
+{
+	std::size_t sum = 0;
+	for (const auto& value : container)
+	{
+		sum += value_of(value);
+	}
+	return sum;
+}
+
+template< typename C >
+std::size_t block_checksum(const C& container)
+{
+	std::size_t sum = 0;
+	for (auto block : container.blocks())
+	{
+		auto values = block.values();
+		if (block.size() == block.extent())
+		{
+			for (const auto& value : values)
+			{
+				sum += value_of(value);
+			}
+			continue;
+		}
+		auto mask = block.mask();
+		for (std::size_t word = 0; word < mask.size(); word++)
+		{
+			for (auto bits = mask[word]; bits != 0; bits &= bits - 1)
+			{
+				sum += value_of(values[word * 64 + std::countr_zero(bits)]);
+			}
+		}
+	}
+	return sum;
+}
+
+template< typename C >
+void churn(C& container, std::size_t rounds, std::mt19937_64& rng)
+{
+	std::size_t count = container.size();
+	for (std::size_t round = 0; round < rounds; round++)
+	{
+		erase_random(container, count / 2, rng);
+		fill(container, count / 2);
+	}
+}
+
+template< typename C >
+void BM_SequentialInsert(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	for (auto _ : state)
+	{
+		C container = make< C >(state);
+		fill(container, count);
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * count));
+}
+
+template< typename C >
+void BM_RandomErase(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	std::mt19937_64 rng(count);
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		C container = make< C >(state);
+		fill(container, count);
+		state.ResumeTiming();
+		erase_random(container, count, rng);
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * count));
+}
+
+template< typename C >
+void BM_Churn(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	std::mt19937_64 rng(count);
+	C container = make< C >(state);
+	fill(container, count);
+	for (auto _ : state)
+	{
+		churn(container, 1, rng);
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * count));
+}
+
+template< typename C >
+void BM_IterateAfterChurn(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	std::mt19937_64 rng(count);
+	C container = make< C >(state);
+	fill(container, count);
+	churn(container, 4, rng);
+	erase_random(container, count / 4, rng);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(checksum(container));
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * container.size()));
+}
+
+template< typename C >
+void BM_IterateBlocksAfterChurn(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	std::mt19937_64 rng(count);
+	C container = make< C >(state);
+	fill(container, count);
+	churn(container, 4, rng);
+	erase_random(container, count / 4, rng);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(block_checksum(container));
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * container.size()));
+}
+
+template< typename C >
+void BM_GetToDistance(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	std::mt19937_64 rng(count);
+	C container = make< C >(state);
+	fill(container, count);
+	churn(container, 4, rng);
+	erase_random(container, count / 4, rng);
+	auto size = static_cast< std::ptrdiff_t >(container.size());
+	for (auto _ : state)
+	{
+		auto distance = static_cast< std::ptrdiff_t >(rng() % static_cast< std::size_t >(size));
+		benchmark::DoNotOptimize(container.get_to_distance(container.begin(), distance));
+	}
+}
+
+template< typename C >
+void BM_Copy(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	std::mt19937_64 rng(count);
+	C container = make< C >(state);
+	fill(container, count);
+	churn(container, 1, rng);
+	for (auto _ : state)
+	{
+		C copy(container);
+		benchmark::DoNotOptimize(copy);
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * container.size()));
+}
+
+template< typename C >
+void BM_Move(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	C container = make< C >(state);
+	fill(container, count);
+	for (auto _ : state)
+	{
+		C moved(std::move(container));
+		container = std::move(moved);
+		benchmark::DoNotOptimize(container);
+	}
+}
+
+template< typename C >
+void BM_ShrinkToFit(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	std::mt19937_64 rng(count);
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		C container = make< C >(state);
+		fill(container, count);
+		erase_random(container, count / 2, rng);
+		state.ResumeTiming();
+		container.shrink_to_fit();
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * count / 2));
+}
+
+template< typename C >
+void BM_SmallStorage(benchmark::State& state)
+{
+	auto count = static_cast< std::size_t >(state.range(0));
+	for (auto _ : state)
+	{
+		C container;
+		fill(container, count);
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(static_cast< std::int64_t >(state.iterations() * count));
+}
+
+static void bucket_args(benchmark::internal::Benchmark* bench)
+{
+	bench->ArgNames({ "n", "block_capacity" })->ArgsProduct({ { 1 << 14 }, { 16, 64, 256, 1024 } });
+}
+
+static void baseline_args(benchmark::internal::Benchmark* bench)
+{
+	bench->ArgNames({ "n" })->Arg(1 << 14);
+}
+
+static void small_args(benchmark::internal::Benchmark* bench)
+{
+	bench->ArgNames({ "n" })->Arg(0)->Arg(4)->Arg(16);
+}
+
+#define BUCKET_BENCHMARKS(T)                                                                                           \
+	BENCHMARK_TEMPLATE(BM_SequentialInsert, BucketStorage< T >)->Apply(bucket_args);                                   \
+	BENCHMARK_TEMPLATE(BM_RandomErase, BucketStorage< T >)->Apply(bucket_args);                                        \
+	BENCHMARK_TEMPLATE(BM_Churn, BucketStorage< T >)->Apply(bucket_args);                                              \
+	BENCHMARK_TEMPLATE(BM_IterateAfterChurn, BucketStorage< T >)->Apply(bucket_args);                                  \
+	BENCHMARK_TEMPLATE(BM_IterateBlocksAfterChurn, BucketStorage< T >)->Apply(bucket_args);                            \
+	BENCHMARK_TEMPLATE(BM_GetToDistance, BucketStorage< T >)->Apply(bucket_args);                                      \
+	BENCHMARK_TEMPLATE(BM_Copy, BucketStorage< T >)->Apply(bucket_args);                                               \
+	BENCHMARK_TEMPLATE(BM_Move, BucketStorage< T >)->Apply(bucket_args);                                               \
+	BENCHMARK_TEMPLATE(BM_ShrinkToFit, BucketStorage< T >)->Apply(bucket_args)
+
+#define FIXED_BENCHMARKS(T, N)                                                                                         \
+	BENCHMARK_TEMPLATE(BM_SequentialInsert, FixedBucketStorage< T, N >)->Apply(baseline_args);                         \
+	BENCHMARK_TEMPLATE(BM_Churn, FixedBucketStorage< T, N >)->Apply(baseline_args);                                    \
+	BENCHMARK_TEMPLATE(BM_IterateAfterChurn, FixedBucketStorage< T, N >)->Apply(baseline_args);                        \
+	BENCHMARK_TEMPLATE(BM_GetToDistance, FixedBucketStorage< T, N >)->Apply(baseline_args)
+
+#define BASELINE_BENCHMARKS(C)                                                                                         \
+	BENCHMARK_TEMPLATE(BM_SequentialInsert, C)->Apply(baseline_args);                                                  \
+	BENCHMARK_TEMPLATE(BM_RandomErase, C)->Apply(baseline_args);                                                       \
+	BENCHMARK_TEMPLATE(BM_Churn, C)->Apply(baseline_args);                                                             \
+	BENCHMARK_TEMPLATE(BM_IterateAfterChurn, C)->Apply(baseline_args);                                                 \
+	BENCHMARK_TEMPLATE(BM_Copy, C)->Apply(baseline_args)
+
+BUCKET_BENCHMARKS(Payload< 8 >);
+BUCKET_BENCHMARKS(Payload< 64 >);
+BUCKET_BENCHMARKS(Payload< 256 >);
+BUCKET_BENCHMARKS(Payload< 1024 >);
+BUCKET_BENCHMARKS(CountedOperationObject);
+
+FIXED_BENCHMARKS(Payload< 8 >, 64);
+FIXED_BENCHMARKS(Payload< 8 >, BucketStorage< Payload< 8 > >::capacity_for(4096));
+FIXED_BENCHMARKS(Payload< 64 >, 64);
+
+BENCHMARK_TEMPLATE(BM_SmallStorage, BucketStorage< Payload< 8 > >)->Apply(small_args);
+BENCHMARK_TEMPLATE(BM_SmallStorage, SmallBucketStorage< Payload< 8 >, 16 >)->Apply(small_args);
+BENCHMARK_TEMPLATE(BM_SmallStorage, std::vector< Payload< 8 > >)->Apply(small_args);
+
+BASELINE_BENCHMARKS(std::list< Payload< 8 > >);
+BASELINE_BENCHMARKS(std::list< Payload< 256 > >);
+BASELINE_BENCHMARKS(std::deque< Payload< 8 > >);
+BASELINE_BENCHMARKS(std::deque< Payload< 256 > >);
+BASELINE_BENCHMARKS(std::vector< Payload< 8 > >);
+BASELINE_BENCHMARKS(std::vector< Payload< 256 > >);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,535 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_CONCURRENT_BUCKET_STORAGE_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_CONCURRENT_BUCKET_STORAGE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+template< typename T >
+class ConcurrentBucketStorage;
+
+template< typename T >
+class ConcurrentBlock
+{
+  private:
+	using value_type = T;
+	using size_type = std::size_t;
+	using pointer = T*;
+
+	template< typename >
+	friend class ConcurrentBucketStorage;
+
+	std::atomic< ConcurrentBlock* > next;
+	std::atomic< std::uint64_t >* tags;
+	std::atomic< std::uint64_t >* free_next;
+	pointer slots;
+	std::atomic< size_type > used;
+	std::mutex lock;
+	std::vector< std::pair< size_type, std::uint64_t > > retired;
+	size_type block_capacity;
+	size_type ordinal;
+
+	ConcurrentBlock(size_type id_block, size_type capacity) :
+		next(nullptr), tags(nullptr), free_next(nullptr), slots(nullptr), used(0), block_capacity(capacity),
+		ordinal(id_block)
+	{
+		tags = new std::atomic< std::uint64_t >[capacity];
+		try
+		{
+			free_next = new std::atomic< std::uint64_t >[capacity];
+			slots = static_cast< pointer >(
+				::operator new(capacity * sizeof(value_type), std::align_val_t(alignof(value_type))));
+		} catch (...)
+		{
+			delete[] free_next;
+			delete[] tags;
+			throw;
+		}
+		for (size_type i = 0; i < capacity; i++)
+		{
+			tags[i].store(0, std::memory_order_relaxed);
+			free_next[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	~ConcurrentBlock()
+	{
+		size_type count = std::min(used.load(std::memory_order_relaxed), block_capacity);
+		for (size_type i = 0; i < count; i++)
+		{
+			if ((tags[i].load(std::memory_order_relaxed) & 3) != 0)
+			{
+				std::destroy_at(slots + i);
+			}
+		}
+		::operator delete(slots, std::align_val_t(alignof(value_type)));
+		delete[] free_next;
+		delete[] tags;
+	}
+};
+
+template< typename T >
+class ConcurrentBucketStorage
+{
+  private:
+	struct ReaderRecord;
+
+  public:
+	using size_type = std::size_t;
+	using value_type = T;
+	using pointer = T*;
+	using reference = T&;
+	using const_reference = const T&;
+
+	class handle
+	{
+	  public:
+		handle() : block(nullptr), slot(0), generation(0) {}
+
+		bool operator==(const handle& other) const
+		{
+			return block == other.block && slot == other.slot && generation == other.generation;
+		}
+
+		explicit operator bool() const noexcept { return block != nullptr; }
+
+	  private:
+		template< typename >
+		friend class ConcurrentBucketStorage;
+
+		handle(ConcurrentBlock< value_type >* b, size_type s, std::uint64_t g) : block(b), slot(s), generation(g) {}
+
+		ConcurrentBlock< value_type >* block;
+		size_type slot;
+		std::uint64_t generation;
+	};
+
+	class reader_guard
+	{
+	  public:
+		reader_guard(const reader_guard&) = delete;
+		reader_guard& operator=(const reader_guard&) = delete;
+
+		~reader_guard() { record->epoch.store(0, std::memory_order_release); }
+
+	  private:
+		template< typename >
+		friend class ConcurrentBucketStorage;
+
+		explicit reader_guard(const ConcurrentBucketStorage* s) : storage(s), record(s->pin()) {}
+
+		const ConcurrentBucketStorage* storage;
+		ReaderRecord* record;
+	};
+
+	explicit ConcurrentBucketStorage(size_type block_capacity = 64);
+	ConcurrentBucketStorage(const ConcurrentBucketStorage& other) = delete;
+	ConcurrentBucketStorage& operator=(const ConcurrentBucketStorage& other) = delete;
+	~ConcurrentBucketStorage();
+
+	handle insert(const value_type& value);
+	handle insert(value_type&& value);
+	template< typename... Args >
+	handle emplace(Args&&... args);
+	bool erase(const handle& h);
+	[[nodiscard]] const value_type* get(const handle& h, const reader_guard& guard) const;
+	[[nodiscard]] bool empty() const noexcept;
+	[[nodiscard]] size_type size() const noexcept;
+	[[nodiscard]] reader_guard read() const;
+	template< typename F >
+	void for_each(F&& f) const;
+	void collect();
+
+  private:
+	static constexpr size_type max_readers = 128;
+	static constexpr size_type retire_threshold = 64;
+	static constexpr size_type directory_segments = 48;
+	static constexpr std::uint64_t index_mask = (std::uint64_t(1) << 40) - 1;
+	static constexpr std::uint64_t state_free = 0;
+	static constexpr std::uint64_t state_live = 1;
+	static constexpr std::uint64_t state_retired = 2;
+
+	struct alignas(64) ReaderRecord
+	{
+		std::atomic< std::uint64_t > epoch{ 0 };
+	};
+
+	struct ReaderSegment
+	{
+		ReaderRecord records[max_readers];
+		std::atomic< ReaderSegment* > next{ nullptr };
+	};
+
+	size_type block_capacity;
+	std::atomic< size_type > current_size;
+	std::atomic< std::uint64_t > epoch;
+	std::atomic< size_type > retired_count;
+	std::atomic< std::uint64_t > free_head;
+	std::atomic< ConcurrentBlock< value_type >* > head;
+	std::atomic< ConcurrentBlock< value_type >* > current;
+	ConcurrentBlock< value_type >* tail;
+	std::atomic< std::atomic< ConcurrentBlock< value_type >* >* > directory[directory_segments];
+	std::atomic< size_type > id_block;
+	std::mutex grow_lock;
+	mutable ReaderSegment readers;
+
+	ReaderRecord* pin() const;
+	void try_advance();
+	void reclaim_all();
+	void reclaim(ConcurrentBlock< value_type >* block);
+	void push_free(ConcurrentBlock< value_type >* block, size_type slot);
+	bool pop_free(ConcurrentBlock< value_type >*& block, size_type& slot);
+	void grow(ConcurrentBlock< value_type >* full);
+	ConcurrentBlock< value_type >* block_at(size_type ordinal) const;
+};
+
+template< typename T >
+ConcurrentBucketStorage< T >::ConcurrentBucketStorage(size_type capacity) :
+	block_capacity(capacity), current_size(0), epoch(1), retired_count(0), free_head(0), head(nullptr),
+	current(nullptr), tail(nullptr), id_block(0)
+{
+	for (auto& segment : directory)
+	{
+		segment.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+template< typename T >
+ConcurrentBucketStorage< T >::~ConcurrentBucketStorage()
+{
+	ConcurrentBlock< value_type >* block = head.load(std::memory_order_acquire);
+	while (block)
+	{
+		ConcurrentBlock< value_type >* next = block->next.load(std::memory_order_relaxed);
+		delete block;
+		block = next;
+	}
+	for (auto& segment : directory)
+	{
+		delete[] segment.load(std::memory_order_relaxed);
+	}
+	ReaderSegment* segment = readers.next.load(std::memory_order_relaxed);
+	while (segment)
+	{
+		ReaderSegment* next = segment->next.load(std::memory_order_relaxed);
+		delete segment;
+		segment = next;
+	}
+}
+
+template< typename T >
+typename ConcurrentBucketStorage< T >::handle ConcurrentBucketStorage< T >::insert(const value_type& value)
+{
+	return emplace(value);
+}
+
+template< typename T >
+typename ConcurrentBucketStorage< T >::handle ConcurrentBucketStorage< T >::insert(value_type&& value)
+{
+	return emplace(std::move(value));
+}
+
+template< typename T >
+template< typename... Args >
+typename ConcurrentBucketStorage< T >::handle ConcurrentBucketStorage< T >::emplace(Args&&... args)
+{
+	ConcurrentBlock< value_type >* block = nullptr;
+	size_type slot = 0;
+	while (!pop_free(block, slot))
+	{
+		block = current.load(std::memory_order_acquire);
+		if (block)
+		{
+			slot = block->used.fetch_add(1, std::memory_order_relaxed);
+			if (slot < block->block_capacity)
+			{
+				break;
+			}
+		}
+		grow(block);
+	}
+
+	std::uint64_t generation = block->tags[slot].load(std::memory_order_relaxed) >> 2;
+	try
+	{
+		::new (static_cast< void* >(block->slots + slot)) value_type(std::forward< Args >(args)...);
+	} catch (...)
+	{
+		push_free(block, slot);
+		throw;
+	}
+	block->tags[slot].store(generation << 2 | state_live, std::memory_order_release);
+	current_size.fetch_add(1, std::memory_order_relaxed);
+	return handle(block, slot, generation);
+}
+
+template< typename T >
+bool ConcurrentBucketStorage< T >::erase(const handle& h)
+{
+	if (!h.block)
+	{
+		return false;
+	}
+	{
+		std::lock_guard< std::mutex > guard(h.block->lock);
+		std::vector< std::pair< size_type, std::uint64_t > >& retired = h.block->retired;
+		if (retired.size() == retired.capacity())
+		{
+			retired.reserve(2 * retired.size() + 1);
+		}
+		std::uint64_t expected = h.generation << 2 | state_live;
+		if (!h.block->tags[h.slot].compare_exchange_strong(expected,
+														   h.generation << 2 | state_retired,
+														   std::memory_order_acq_rel))
+		{
+			return false;
+		}
+		retired.emplace_back(h.slot, epoch.load(std::memory_order_seq_cst));
+	}
+	current_size.fetch_sub(1, std::memory_order_relaxed);
+
+	size_type limit = std::max(retire_threshold, id_block.load(std::memory_order_relaxed));
+	if (retired_count.fetch_add(1, std::memory_order_relaxed) + 1 >= limit &&
+		retired_count.exchange(0, std::memory_order_relaxed) >= limit)
+	{
+		try_advance();
+		reclaim_all();
+	}
+	return true;
+}
+
+template< typename T >
+const T* ConcurrentBucketStorage< T >::get(const handle& h, const reader_guard& guard) const
+{
+	if (guard.storage != this)
+	{
+		throw std::invalid_argument("ConcurrentBucketStorage: reader guard belongs to another storage");
+	}
+	if (!h.block)
+	{
+		return nullptr;
+	}
+	std::uint64_t tag = h.block->tags[h.slot].load(std::memory_order_acquire);
+	return tag == (h.generation << 2 | state_live) ? h.block->slots + h.slot : nullptr;
+}
+
+template< typename T >
+bool ConcurrentBucketStorage< T >::empty() const noexcept
+{
+	return size() == 0;
+}
+
+template< typename T >
+typename ConcurrentBucketStorage< T >::size_type ConcurrentBucketStorage< T >::size() const noexcept
+{
+	return current_size.load(std::memory_order_relaxed);
+}
+
+template< typename T >
+typename ConcurrentBucketStorage< T >::reader_guard ConcurrentBucketStorage< T >::read() const
+{
+	return reader_guard(this);
+}
+
+template< typename T >
+template< typename F >
+void ConcurrentBucketStorage< T >::for_each(F&& f) const
+{
+	reader_guard guard = read();
+	for (ConcurrentBlock< value_type >* block = head.load(std::memory_order_acquire); block;
+		 block = block->next.load(std::memory_order_acquire))
+	{
+		size_type count = std::min(block->used.load(std::memory_order_acquire), block->block_capacity);
+		for (size_type i = 0; i < count; i++)
+		{
+			if ((block->tags[i].load(std::memory_order_acquire) & 3) == state_live)
+			{
+				f(static_cast< const_reference >(block->slots[i]));
+			}
+		}
+	}
+}
+
+template< typename T >
+void ConcurrentBucketStorage< T >::collect()
+{
+	try_advance();
+	try_advance();
+	reclaim_all();
+}
+
+template< typename T >
+void ConcurrentBucketStorage< T >::reclaim_all()
+{
+	for (ConcurrentBlock< value_type >* block = head.load(std::memory_order_acquire); block;
+		 block = block->next.load(std::memory_order_acquire))
+	{
+		reclaim(block);
+	}
+}
+
+template< typename T >
+typename ConcurrentBucketStorage< T >::ReaderRecord* ConcurrentBucketStorage< T >::pin() const
+{
+	for (ReaderSegment* segment = &readers;;)
+	{
+		for (ReaderRecord& record : segment->records)
+		{
+			std::uint64_t expected = 0;
+			if (record.epoch.compare_exchange_strong(expected,
+													 epoch.load(std::memory_order_seq_cst),
+													 std::memory_order_seq_cst))
+			{
+				return &record;
+			}
+		}
+		ReaderSegment* next = segment->next.load(std::memory_order_acquire);
+		if (!next)
+		{
+			auto* created = new ReaderSegment();
+			if (segment->next.compare_exchange_strong(next, created, std::memory_order_acq_rel))
+			{
+				next = created;
+			}
+			else
+			{
+				delete created;
+			}
+		}
+		segment = next;
+	}
+}
+
+template< typename T >
+void ConcurrentBucketStorage< T >::try_advance()
+{
+	std::uint64_t global = epoch.load(std::memory_order_seq_cst);
+	for (const ReaderSegment* segment = &readers; segment; segment = segment->next.load(std::memory_order_acquire))
+	{
+		for (const ReaderRecord& record : segment->records)
+		{
+			std::uint64_t local = record.epoch.load(std::memory_order_seq_cst);
+			if (local != 0 && local != global)
+			{
+				return;
+			}
+		}
+	}
+	epoch.compare_exchange_strong(global, global + 1, std::memory_order_seq_cst);
+}
+
+template< typename T >
+void ConcurrentBucketStorage< T >::reclaim(ConcurrentBlock< value_type >* block)
+{
+	std::uint64_t safe = epoch.load(std::memory_order_seq_cst);
+	std::vector< size_type > ready;
+	{
+		std::lock_guard< std::mutex > guard(block->lock);
+		auto it = block->retired.begin();
+		for (auto& entry : block->retired)
+		{
+			if (entry.second + 2 <= safe)
+			{
+				ready.push_back(entry.first);
+			}
+			else
+			{
+				*it++ = entry;
+			}
+		}
+		block->retired.erase(it, block->retired.end());
+	}
+	for (size_type slot : ready)
+	{
+		std::destroy_at(block->slots + slot);
+		std::uint64_t generation = block->tags[slot].load(std::memory_order_relaxed) >> 2;
+		block->tags[slot].store((generation + 1) << 2 | state_free, std::memory_order_release);
+		push_free(block, slot);
+	}
+}
+
+template< typename T >
+void ConcurrentBucketStorage< T >::push_free(ConcurrentBlock< value_type >* block, size_type slot)
+{
+	std::uint64_t id = block->ordinal * block_capacity + slot + 1;
+	std::uint64_t old_head = free_head.load(std::memory_order_relaxed);
+	do
+	{
+		block->free_next[slot].store(old_head & index_mask, std::memory_order_relaxed);
+	} while (!free_head.compare_exchange_weak(old_head,
+											  ((old_head >> 40) + 1) << 40 | id,
+											  std::memory_order_release,
+											  std::memory_order_relaxed));
+}
+
+template< typename T >
+bool ConcurrentBucketStorage< T >::pop_free(ConcurrentBlock< value_type >*& block, size_type& slot)
+{
+	std::uint64_t old_head = free_head.load(std::memory_order_acquire);
+	while (old_head & index_mask)
+	{
+		std::uint64_t id = (old_head & index_mask) - 1;
+		ConcurrentBlock< value_type >* candidate = block_at(id / block_capacity);
+		std::uint64_t next = candidate->free_next[id % block_capacity].load(std::memory_order_relaxed);
+		if (free_head.compare_exchange_weak(old_head,
+											((old_head >> 40) + 1) << 40 | next,
+											std::memory_order_acquire,
+											std::memory_order_acquire))
+		{
+			block = candidate;
+			slot = id % block_capacity;
+			return true;
+		}
+	}
+	return false;
+}
+
+template< typename T >
+void ConcurrentBucketStorage< T >::grow(ConcurrentBlock< value_type >* full)
+{
+	std::lock_guard< std::mutex > guard(grow_lock);
+	if (current.load(std::memory_order_relaxed) != full)
+	{
+		return;
+	}
+	size_type ordinal = id_block.load(std::memory_order_relaxed);
+	size_type segment = std::bit_width(ordinal + 1) - 1;
+	if (!directory[segment].load(std::memory_order_relaxed))
+	{
+		auto* entries = new std::atomic< ConcurrentBlock< value_type >* >[size_type(1) << segment];
+		directory[segment].store(entries, std::memory_order_release);
+	}
+	auto* block = new ConcurrentBlock< value_type >(ordinal, block_capacity);
+	directory[segment].load(std::memory_order_relaxed)[ordinal + 1 - (size_type(1) << segment)].store(
+		block,
+		std::memory_order_release);
+	id_block.fetch_add(1, std::memory_order_relaxed);
+	if (tail)
+	{
+		tail->next.store(block, std::memory_order_release);
+	}
+	else
+	{
+		head.store(block, std::memory_order_release);
+	}
+	tail = block;
+	current.store(block, std::memory_order_release);
+}
+
+template< typename T >
+ConcurrentBlock< T >* ConcurrentBucketStorage< T >::block_at(size_type ordinal) const
+{
+	size_type segment = std::bit_width(ordinal + 1) - 1;
+	return directory[segment].load(std::memory_order_acquire)[ordinal + 1 - (size_type(1) << segment)].load(
+		std::memory_order_acquire);
+}
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_CONCURRENT_BUCKET_STORAGE_HPP
@@ -0,0 +1,246 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_HOLE_INDEX_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_HOLE_INDEX_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+template< typename T, std::size_t N >
+class Block;
+
+enum class ReusePolicy
+{
+	lifo,
+	fullest,
+	lowest_address,
+	hint
+};
+
+template< typename T, typename Allocator, std::size_t N >
+class HoleIndex
+{
+  private:
+	using value_type = T;
+	using size_type = std::size_t;
+	using heap_allocator =
+		typename std::allocator_traits< Allocator >::template rebind_alloc< Block< value_type, N >* >;
+
+	template< typename, typename, std::size_t, std::size_t >
+	friend class BucketStorage;
+
+	static constexpr size_type bucket_count = 64;
+
+	ReusePolicy policy;
+	Block< value_type, N >* lists[bucket_count];
+	std::uint64_t nonempty;
+	std::vector< Block< value_type, N >*, heap_allocator > heap;
+	size_type count;
+
+	explicit HoleIndex(const Allocator& allocator) :
+		policy(ReusePolicy::lifo), lists{}, nonempty(0), heap(allocator), count(0)
+	{
+	}
+
+	[[nodiscard]] bool empty() const { return count == 0; }
+
+	void reserve(size_type blocks)
+	{
+		if (policy == ReusePolicy::lowest_address && blocks > heap.capacity())
+		{
+			heap.reserve(std::max(blocks, 2 * heap.capacity()));
+		}
+	}
+
+	static size_type bucket_of(const Block< value_type, N >* block)
+	{
+		return std::bit_width(block->block_used - block->block_size) - 1;
+	}
+
+	static bool before(const Block< value_type, N >* a, const Block< value_type, N >* b)
+	{
+		return std::less< const void* >()(a->storage, b->storage);
+	}
+
+	Block< value_type, N >* pick() const
+	{
+		if (count == 0)
+		{
+			return nullptr;
+		}
+		if (policy == ReusePolicy::lowest_address)
+		{
+			return heap.front();
+		}
+		return lists[policy == ReusePolicy::fullest ? std::countr_zero(nonempty) : 0];
+	}
+
+	void add(Block< value_type, N >* block)
+	{
+		if (policy == ReusePolicy::lowest_address)
+		{
+			heap.push_back(block);
+			block->hole_slot = heap.size() - 1;
+			sift_up(block->hole_slot);
+		}
+		else
+		{
+			link(block, policy == ReusePolicy::fullest ? bucket_of(block) : 0);
+		}
+		count++;
+	}
+
+	void remove(Block< value_type, N >* block)
+	{
+		if (policy == ReusePolicy::lowest_address)
+		{
+			size_type slot = block->hole_slot;
+			place(slot, heap.back());
+			heap.pop_back();
+			if (slot < heap.size())
+			{
+				sift_down(slot);
+				sift_up(slot);
+			}
+		}
+		else
+		{
+			unlink(block);
+		}
+		count--;
+	}
+
+	void update(Block< value_type, N >* block, bool erased)
+	{
+		if (policy == ReusePolicy::fullest)
+		{
+			size_type bucket = bucket_of(block);
+			if (bucket != block->hole_slot)
+			{
+				unlink(block);
+				link(block, bucket);
+			}
+		}
+		else if (policy != ReusePolicy::lowest_address && erased && lists[0] != block)
+		{
+			unlink(block);
+			link(block, 0);
+		}
+	}
+
+	void relink(Block< value_type, N >* block)
+	{
+		if (policy == ReusePolicy::lowest_address)
+		{
+			heap[block->hole_slot] = block;
+			return;
+		}
+		if (block->hole_prev)
+		{
+			block->hole_prev->hole_next = block;
+		}
+		else
+		{
+			lists[block->hole_slot] = block;
+		}
+		if (block->hole_next)
+		{
+			block->hole_next->hole_prev = block;
+		}
+	}
+
+	void clear()
+	{
+		for (; nonempty != 0; nonempty &= nonempty - 1)
+		{
+			lists[std::countr_zero(nonempty)] = nullptr;
+		}
+		heap.clear();
+		count = 0;
+	}
+
+	void swap(HoleIndex& other)
+	{
+		std::swap(policy, other.policy);
+		std::swap(lists, other.lists);
+		std::swap(nonempty, other.nonempty);
+		heap.swap(other.heap);
+		std::swap(count, other.count);
+	}
+
+	void link(Block< value_type, N >* block, size_type bucket)
+	{
+		block->hole_slot = bucket;
+		block->hole_prev = nullptr;
+		block->hole_next = lists[bucket];
+		if (lists[bucket])
+		{
+			lists[bucket]->hole_prev = block;
+		}
+		lists[bucket] = block;
+		nonempty |= std::uint64_t(1) << bucket;
+	}
+
+	void unlink(Block< value_type, N >* block)
+	{
+		if (block->hole_prev)
+		{
+			block->hole_prev->hole_next = block->hole_next;
+		}
+		else
+		{
+			lists[block->hole_slot] = block->hole_next;
+		}
+		if (block->hole_next)
+		{
+			block->hole_next->hole_prev = block->hole_prev;
+		}
+		if (!lists[block->hole_slot])
+		{
+			nonempty &= ~(std::uint64_t(1) << block->hole_slot);
+		}
+	}
+
+	void place(size_type slot, Block< value_type, N >* block)
+	{
+		heap[slot] = block;
+		block->hole_slot = slot;
+	}
+
+	void sift_up(size_type slot)
+	{
+		Block< value_type, N >* block = heap[slot];
+		while (slot > 0 && before(block, heap[(slot - 1) / 2]))
+		{
+			place(slot, heap[(slot - 1) / 2]);
+			slot = (slot - 1) / 2;
+		}
+		place(slot, block);
+	}
+
+	void sift_down(size_type slot)
+	{
+		Block< value_type, N >* block = heap[slot];
+		while (2 * slot + 1 < heap.size())
+		{
+			size_type child = 2 * slot + 1;
+			if (child + 1 < heap.size() && before(heap[child + 1], heap[child]))
+			{
+				child++;
+			}
+			if (!before(heap[child], block))
+			{
+				break;
+			}
+			place(slot, heap[child]);
+			slot = child;
+		}
+		place(slot, block);
+	}
+};
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_HOLE_INDEX_HPP
@@ -0,0 +1,716 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_SOA_BUCKET_STORAGE_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_SOA_BUCKET_STORAGE_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template< typename... Fields >
+class SoABucketStorage;
+
+template< bool Const, typename... Fields >
+class SoAIterator;
+
+template< bool Const, typename... Fields >
+class SoABlockView;
+
+template< bool Const, typename... Fields >
+class SoABlockIterator;
+
+template< typename... Fields >
+class SoABlock
+{
+  private:
+	using size_type = std::size_t;
+	using mask_type = std::uint64_t;
+
+	template< typename... >
+	friend class SoABucketStorage;
+
+	template< bool, typename... >
+	friend class SoAIterator;
+
+	template< bool, typename... >
+	friend class SoABlockView;
+
+	template< bool, typename... >
+	friend class SoABlockIterator;
+
+	static constexpr size_type mask_bits = 64;
+	static constexpr size_type npos = std::numeric_limits< size_type >::max();
+	static constexpr size_type column_alignment = std::max({ std::size_t(64), alignof(Fields)... });
+
+	struct alignas(column_alignment) chunk_type
+	{
+		unsigned char bytes[column_alignment];
+	};
+
+	using layout_type = std::array< size_type, sizeof...(Fields) + 2 >;
+
+	static constexpr size_type mask_words(size_type capacity) { return (capacity + mask_bits - 1) / mask_bits; }
+
+	static constexpr size_type align_up(size_type offset, size_type alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	static layout_type layout(size_type capacity)
+	{
+		layout_type offsets{};
+		offsets[0] = mask_words(capacity) * sizeof(mask_type);
+		size_type offset = align_up(offsets[0] + capacity * sizeof(size_type), column_alignment);
+		size_type field = 1;
+		((offsets[field++] = offset, offset = align_up(offset + capacity * sizeof(Fields), column_alignment)), ...);
+		offsets[field] = offset / sizeof(chunk_type);
+		return offsets;
+	}
+
+	chunk_type* storage;
+	mask_type* occupancy;
+	size_type* free_next;
+	std::tuple< Fields*... > columns;
+	SoABlock* next;
+	SoABlock* prev;
+	size_type block_capacity;
+	size_type block_used;
+	size_type block_size;
+	size_type free_head;
+	size_type hole_slot;
+
+	SoABlock(size_type capacity, chunk_type* buffer, const layout_type& offsets) :
+		storage(buffer), occupancy(reinterpret_cast< mask_type* >(buffer)),
+		free_next(reinterpret_cast< size_type* >(reinterpret_cast< unsigned char* >(buffer) + offsets[0])),
+		columns(), next(nullptr), prev(nullptr), block_capacity(capacity), block_used(0), block_size(0),
+		free_head(npos), hole_slot(npos)
+	{
+		auto* bytes = reinterpret_cast< unsigned char* >(buffer);
+		[&]< std::size_t... I >(std::index_sequence< I... >)
+		{
+			((std::get< I >(columns) = reinterpret_cast< Fields* >(bytes + offsets[I + 1])), ...);
+		}(std::index_sequence_for< Fields... >{});
+		std::fill(occupancy, occupancy + mask_words(capacity), mask_type(0));
+	}
+
+	bool is_occupied(size_type slot) const { return (occupancy[slot / mask_bits] >> (slot % mask_bits)) & 1; }
+
+	void set_occupied(size_type slot, bool value)
+	{
+		if (value)
+		{
+			occupancy[slot / mask_bits] |= mask_type(1) << (slot % mask_bits);
+		}
+		else
+		{
+			occupancy[slot / mask_bits] &= ~(mask_type(1) << (slot % mask_bits));
+		}
+	}
+
+	size_type next_active(size_type from) const
+	{
+		size_type words = mask_words(block_used);
+		size_type word = from / mask_bits;
+		if (word >= words)
+		{
+			return npos;
+		}
+		mask_type bits = occupancy[word] & (~mask_type(0) << (from % mask_bits));
+		while (bits == 0)
+		{
+			if (++word == words)
+			{
+				return npos;
+			}
+			bits = occupancy[word];
+		}
+		size_type slot = word * mask_bits + std::countr_zero(bits);
+		return slot < block_used ? slot : npos;
+	}
+
+	size_type prev_active(size_type before) const
+	{
+		if (before == 0)
+		{
+			return npos;
+		}
+		size_type word = --before / mask_bits;
+		mask_type bits = occupancy[word] & (~mask_type(0) >> (mask_bits - 1 - before % mask_bits));
+		while (bits == 0)
+		{
+			if (word-- == 0)
+			{
+				return npos;
+			}
+			bits = occupancy[word];
+		}
+		return word * mask_bits + (mask_bits - 1 - std::countl_zero(bits));
+	}
+};
+
+template< bool Const, typename... Fields >
+class SoAIterator
+{
+  public:
+	using iterator_category = std::bidirectional_iterator_tag;
+	using value_type = std::tuple< Fields... >;
+	using difference_type = std::ptrdiff_t;
+	using reference = std::conditional_t< Const, std::tuple< const Fields&... >, std::tuple< Fields&... > >;
+
+  private:
+	using size_type = std::size_t;
+	using block_type = SoABlock< Fields... >;
+
+	template< typename... >
+	friend class SoABucketStorage;
+
+	template< bool, typename... >
+	friend class SoAIterator;
+
+	block_type* current_block;
+	size_type current_slot;
+	block_type* const* last_block;
+
+	SoAIterator(block_type* block, size_type slot, block_type* const* last) :
+		current_block(block), current_slot(slot), last_block(last)
+	{
+	}
+
+  public:
+	SoAIterator() : current_block(nullptr), current_slot(0), last_block(nullptr) {}
+
+	template< bool OtherConst >
+		requires(Const && !OtherConst)
+	SoAIterator(const SoAIterator< OtherConst, Fields... >& other) :
+		current_block(other.current_block), current_slot(other.current_slot), last_block(other.last_block)
+	{
+	}
+
+	reference operator*() const
+	{
+		return [&]< std::size_t... I >(std::index_sequence< I... >)
+		{
+			return reference(std::get< I >(current_block->columns)[current_slot]...);
+		}(std::index_sequence_for< Fields... >{});
+	}
+
+	template< std::size_t I >
+	auto& get() const
+	{
+		auto& field = std::get< I >(current_block->columns)[current_slot];
+		if constexpr (Const)
+		{
+			return std::as_const(field);
+		}
+		else
+		{
+			return field;
+		}
+	}
+
+	SoAIterator& operator++()
+	{
+		current_slot = current_block->next_active(current_slot + 1);
+		if (current_slot == block_type::npos)
+		{
+			current_block = current_block->next;
+			current_slot = current_block ? current_block->next_active(0) : 0;
+		}
+		return *this;
+	}
+
+	SoAIterator operator++(int)
+	{
+		SoAIterator temp = *this;
+		++(*this);
+		return temp;
+	}
+
+	SoAIterator& operator--()
+	{
+		size_type slot = current_block ? current_block->prev_active(current_slot) : block_type::npos;
+		if (slot == block_type::npos)
+		{
+			current_block = current_block ? current_block->prev : *last_block;
+			slot = current_block->prev_active(current_block->block_used);
+		}
+		current_slot = slot;
+		return *this;
+	}
+
+	SoAIterator operator--(int)
+	{
+		SoAIterator temp = *this;
+		--(*this);
+		return temp;
+	}
+
+	template< bool OtherConst >
+	bool operator==(const SoAIterator< OtherConst, Fields... >& other) const
+	{
+		return current_block == other.current_block && current_slot == other.current_slot;
+	}
+};
+
+template< bool Const, typename... Fields >
+class SoABlockView
+{
+  private:
+	using size_type = std::size_t;
+	using mask_type = std::uint64_t;
+	using block_type = SoABlock< Fields... >;
+
+	template< typename... >
+	friend class SoABucketStorage;
+
+	template< bool, typename... >
+	friend class SoABlockIterator;
+
+	template< std::size_t I >
+	using field_type = std::tuple_element_t< I, std::tuple< Fields... > >;
+
+	const block_type* block;
+
+	explicit SoABlockView(const block_type* block) : block(block) {}
+
+  public:
+	[[nodiscard]] size_type size() const noexcept { return block->block_size; }
+	[[nodiscard]] size_type extent() const noexcept { return block->block_used; }
+	[[nodiscard]] bool occupied(size_type slot) const { return block->is_occupied(slot); }
+
+	[[nodiscard]] std::span< const mask_type > mask() const
+	{
+		return { block->occupancy, block_type::mask_words(block->block_used) };
+	}
+
+	template< std::size_t I >
+	[[nodiscard]] auto field() const
+	{
+		using element = std::conditional_t< Const, const field_type< I >, field_type< I > >;
+		return std::span< element >(std::get< I >(block->columns), block->block_used);
+	}
+};
+
+template< bool Const, typename... Fields >
+class SoABlockIterator
+{
+  public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = SoABlockView< Const, Fields... >;
+	using difference_type = std::ptrdiff_t;
+
+  private:
+	using block_type = SoABlock< Fields... >;
+
+	template< typename... >
+	friend class SoABucketStorage;
+
+	const block_type* current_block;
+
+	explicit SoABlockIterator(const block_type* block) : current_block(block) {}
+
+  public:
+	SoABlockIterator() : current_block(nullptr) {}
+
+	value_type operator*() const { return value_type(current_block); }
+
+	SoABlockIterator& operator++()
+	{
+		current_block = current_block->next;
+		return *this;
+	}
+
+	SoABlockIterator operator++(int)
+	{
+		SoABlockIterator temp = *this;
+		++(*this);
+		return temp;
+	}
+
+	bool operator==(const SoABlockIterator& other) const { return current_block == other.current_block; }
+};
+
+template< typename... Fields >
+class SoABucketStorage
+{
+	static_assert(sizeof...(Fields) > 0, "SoABucketStorage needs at least one field");
+	static_assert((std::is_trivially_copyable_v< Fields > && ...),
+				  "SoABucketStorage fields have to be trivially copyable");
+
+  public:
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using value_type = std::tuple< Fields... >;
+	using reference = std::tuple< Fields&... >;
+	using const_reference = std::tuple< const Fields&... >;
+	using iterator = SoAIterator< false, Fields... >;
+	using const_iterator = SoAIterator< true, Fields... >;
+	using block_view = SoABlockView< false, Fields... >;
+	using const_block_view = SoABlockView< true, Fields... >;
+	using block_range = std::ranges::subrange< SoABlockIterator< false, Fields... > >;
+	using const_block_range = std::ranges::subrange< SoABlockIterator< true, Fields... > >;
+
+  private:
+	using block_type = SoABlock< Fields... >;
+	using chunk_type = typename block_type::chunk_type;
+	using layout_type = typename block_type::layout_type;
+
+	size_type current_size;
+	size_type block_capacity;
+	size_type current_capacity;
+	layout_type offsets;
+	std::vector< block_type* > holes;
+	std::vector< block_type* > deleted_blocks;
+	block_type* head;
+	block_type* tail;
+
+	block_type* create_block();
+	void destroy_block(block_type* block) noexcept;
+	void destroy_blocks() noexcept;
+	void copy(const SoABucketStorage& other);
+	void link_block(block_type* block);
+	void release_block(block_type* block);
+	void add_hole(block_type* block);
+	void remove_hole(block_type* block);
+
+	template< std::size_t... I >
+	iterator insert_impl(std::index_sequence< I... >, const Fields&... values);
+
+  public:
+	explicit SoABucketStorage(size_type block_capacity = 64);
+	SoABucketStorage(const SoABucketStorage& other);
+	SoABucketStorage(SoABucketStorage&& other) noexcept;
+	SoABucketStorage& operator=(const SoABucketStorage& other);
+	SoABucketStorage& operator=(SoABucketStorage&& other) noexcept;
+	~SoABucketStorage();
+
+	iterator begin() noexcept { return head ? iterator(head, head->next_active(0), &tail) : end(); }
+	iterator end() noexcept { return iterator(nullptr, 0, &tail); }
+	const_iterator begin() const noexcept { return head ? const_iterator(head, head->next_active(0), &tail) : end(); }
+	const_iterator end() const noexcept { return const_iterator(nullptr, 0, &tail); }
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+
+	block_range blocks() noexcept;
+	const_block_range blocks() const noexcept;
+
+	iterator insert(const Fields&... values);
+	iterator insert(const value_type& value);
+	iterator erase(const_iterator it);
+	[[nodiscard]] bool empty() const noexcept { return current_size == 0; }
+	[[nodiscard]] size_type size() const noexcept { return current_size; }
+	[[nodiscard]] size_type capacity() const noexcept { return current_capacity; }
+	void clear();
+	void swap(SoABucketStorage& other) noexcept;
+};
+
+template< typename... Fields >
+SoABucketStorage< Fields... >::SoABucketStorage(size_type block_capacity) :
+	current_size(0), block_capacity(block_capacity), current_capacity(0), offsets(block_type::layout(block_capacity)),
+	holes(), deleted_blocks(), head(nullptr), tail(nullptr)
+{
+	if (block_capacity == 0)
+	{
+		throw std::invalid_argument("SoABucketStorage: block capacity must be positive");
+	}
+}
+
+template< typename... Fields >
+SoABucketStorage< Fields... >::SoABucketStorage(const SoABucketStorage& other) :
+	SoABucketStorage(other.block_capacity)
+{
+	copy(other);
+}
+
+template< typename... Fields >
+SoABucketStorage< Fields... >::SoABucketStorage(SoABucketStorage&& other) noexcept :
+	current_size(std::exchange(other.current_size, 0)), block_capacity(other.block_capacity),
+	current_capacity(std::exchange(other.current_capacity, 0)), offsets(other.offsets),
+	holes(std::move(other.holes)), deleted_blocks(std::move(other.deleted_blocks)),
+	head(std::exchange(other.head, nullptr)), tail(std::exchange(other.tail, nullptr))
+{
+	other.holes.clear();
+	other.deleted_blocks.clear();
+}
+
+template< typename... Fields >
+SoABucketStorage< Fields... >& SoABucketStorage< Fields... >::operator=(const SoABucketStorage& other)
+{
+	if (this != &other)
+	{
+		SoABucketStorage temp(other);
+		swap(temp);
+	}
+	return *this;
+}
+
+template< typename... Fields >
+SoABucketStorage< Fields... >& SoABucketStorage< Fields... >::operator=(SoABucketStorage&& other) noexcept
+{
+	if (this != &other)
+	{
+		SoABucketStorage temp(std::move(other));
+		swap(temp);
+	}
+	return *this;
+}
+
+template< typename... Fields >
+SoABucketStorage< Fields... >::~SoABucketStorage()
+{
+	destroy_blocks();
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::swap(SoABucketStorage& other) noexcept
+{
+	std::swap(current_size, other.current_size);
+	std::swap(block_capacity, other.block_capacity);
+	std::swap(current_capacity, other.current_capacity);
+	std::swap(offsets, other.offsets);
+	holes.swap(other.holes);
+	deleted_blocks.swap(other.deleted_blocks);
+	std::swap(head, other.head);
+	std::swap(tail, other.tail);
+}
+
+template< typename... Fields >
+SoABlock< Fields... >* SoABucketStorage< Fields... >::create_block()
+{
+	std::allocator< chunk_type > c_alloc;
+	chunk_type* buffer = c_alloc.allocate(offsets.back());
+	try
+	{
+		return new block_type(block_capacity, buffer, offsets);
+	} catch (...)
+	{
+		c_alloc.deallocate(buffer, offsets.back());
+		throw;
+	}
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::destroy_block(block_type* block) noexcept
+{
+	std::allocator< chunk_type > c_alloc;
+	c_alloc.deallocate(block->storage, block_type::layout(block->block_capacity).back());
+	delete block;
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::destroy_blocks() noexcept
+{
+	while (head)
+	{
+		destroy_block(std::exchange(head, head->next));
+	}
+	for (block_type* block : deleted_blocks)
+	{
+		destroy_block(block);
+	}
+	deleted_blocks.clear();
+	holes.clear();
+	tail = nullptr;
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::clear()
+{
+	destroy_blocks();
+	current_size = 0;
+	current_capacity = 0;
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::copy(const SoABucketStorage& other)
+{
+	size_type blocks = other.current_capacity / other.block_capacity;
+	holes.reserve(blocks);
+	deleted_blocks.reserve(blocks);
+	holes.resize(other.holes.size());
+	for (const block_type* other_block = other.head; other_block; other_block = other_block->next)
+	{
+		block_type* block = create_block();
+		std::memcpy(block->storage, other_block->storage, offsets.back() * sizeof(chunk_type));
+		block->block_used = other_block->block_used;
+		block->block_size = other_block->block_size;
+		block->free_head = other_block->free_head;
+		block->hole_slot = other_block->hole_slot;
+		if (block->hole_slot != block_type::npos)
+		{
+			holes[block->hole_slot] = block;
+		}
+		link_block(block);
+	}
+	current_size = other.current_size;
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::link_block(block_type* block)
+{
+	block->prev = tail;
+	block->next = nullptr;
+	if (tail)
+	{
+		tail->next = block;
+	}
+	else
+	{
+		head = block;
+	}
+	tail = block;
+	current_capacity += block->block_capacity;
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::release_block(block_type* block)
+{
+	if (block->hole_slot != block_type::npos)
+	{
+		remove_hole(block);
+	}
+	if (block->prev)
+	{
+		block->prev->next = block->next;
+	}
+	else
+	{
+		head = block->next;
+	}
+	if (block->next)
+	{
+		block->next->prev = block->prev;
+	}
+	else
+	{
+		tail = block->prev;
+	}
+	std::fill(block->occupancy, block->occupancy + block_type::mask_words(block->block_used), 0);
+	block->block_used = 0;
+	block->block_size = 0;
+	block->free_head = block_type::npos;
+	current_capacity -= block->block_capacity;
+	deleted_blocks.push_back(block);
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::add_hole(block_type* block)
+{
+	block->hole_slot = holes.size();
+	holes.push_back(block);
+}
+
+template< typename... Fields >
+void SoABucketStorage< Fields... >::remove_hole(block_type* block)
+{
+	holes[block->hole_slot] = holes.back();
+	holes[block->hole_slot]->hole_slot = block->hole_slot;
+	holes.pop_back();
+	block->hole_slot = block_type::npos;
+}
+
+template< typename... Fields >
+template< std::size_t... I >
+typename SoABucketStorage< Fields... >::iterator
+	SoABucketStorage< Fields... >::insert_impl(std::index_sequence< I... >, const Fields&... values)
+{
+	block_type* block;
+	size_type slot;
+	if (!holes.empty())
+	{
+		block = holes.back();
+		slot = block->free_head;
+		block->free_head = block->free_next[slot];
+		if (block->free_head == block_type::npos)
+		{
+			remove_hole(block);
+		}
+	}
+	else
+	{
+		if (!tail || tail->block_used == tail->block_capacity)
+		{
+			size_type blocks = current_capacity / block_capacity + deleted_blocks.size() + 1;
+			holes.reserve(blocks);
+			deleted_blocks.reserve(blocks);
+			if (deleted_blocks.empty())
+			{
+				link_block(create_block());
+			}
+			else
+			{
+				link_block(deleted_blocks.back());
+				deleted_blocks.pop_back();
+			}
+		}
+		block = tail;
+		slot = block->block_used++;
+	}
+	(std::construct_at(std::get< I >(block->columns) + slot, values), ...);
+	block->set_occupied(slot, true);
+	block->block_size++;
+	current_size++;
+	return iterator(block, slot, &tail);
+}
+
+template< typename... Fields >
+typename SoABucketStorage< Fields... >::iterator SoABucketStorage< Fields... >::insert(const Fields&... values)
+{
+	return insert_impl(std::index_sequence_for< Fields... >{}, values...);
+}
+
+template< typename... Fields >
+typename SoABucketStorage< Fields... >::iterator SoABucketStorage< Fields... >::insert(const value_type& value)
+{
+	return std::apply([this](const Fields&... values) { return insert(values...); }, value);
+}
+
+template< typename... Fields >
+typename SoABucketStorage< Fields... >::iterator SoABucketStorage< Fields... >::erase(const_iterator it)
+{
+	block_type* block = it.current_block;
+	size_type slot = it.current_slot;
+	++it;
+	iterator next(it.current_block, it.current_slot, &tail);
+
+	block->set_occupied(slot, false);
+	current_size--;
+	if (--block->block_size == 0)
+	{
+		release_block(block);
+		return next;
+	}
+	block->free_next[slot] = block->free_head;
+	if (block->free_head == block_type::npos)
+	{
+		add_hole(block);
+	}
+	block->free_head = slot;
+	return next;
+}
+
+template< typename... Fields >
+typename SoABucketStorage< Fields... >::block_range SoABucketStorage< Fields... >::blocks() noexcept
+{
+	return block_range(SoABlockIterator< false, Fields... >(head), SoABlockIterator< false, Fields... >(nullptr));
+}
+
+template< typename... Fields >
+typename SoABucketStorage< Fields... >::const_block_range SoABucketStorage< Fields... >::blocks() const noexcept
+{
+	return const_block_range(SoABlockIterator< true, Fields... >(head), SoABlockIterator< true, Fields... >(nullptr));
+}
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_SOA_BUCKET_STORAGE_HPP
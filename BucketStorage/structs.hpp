@@ -5,12 +5,23 @@
 #ifndef CT_C24_LW_CONTAINERS_NUDA9A_STRUCTS_HPP
 #define CT_C24_LW_CONTAINERS_NUDA9A_STRUCTS_HPP
 
-template< typename T >
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+template< typename T, typename Allocator, std::size_t Capacity, std::size_t Inline >
 class BucketStorage;
 
-template< typename T >
+template< typename T, std::size_t N >
 class Block;
 
+template< typename T, std::size_t N >
+class BlockIndex;
+
 template< typename T >
 class Node
 {
@@ -19,83 +30,151 @@ class Node
 	using size_type = std::size_t;
 	using pointer = T*;
 
-	template< typename >
+	template< typename, std::size_t >
 	friend class ConstIterator;
 
-	template< typename >
+	template< typename, std::size_t >
 	friend class Iterator;
 
-	template< typename >
+	template< typename, std::size_t >
 	friend class Block;
 
-	template< typename >
+	template< typename, typename, std::size_t, std::size_t >
 	friend class BucketStorage;
 
 	template< typename >
-	friend class MyStack;
-
-	pointer value_ptr;
-	size_type node_id;
-	Node* next;
-	Node* prev;
-	Block< value_type >* block;
-	bool is_active;
-
-	Node() : block(nullptr), value_ptr(nullptr), next(nullptr), prev(nullptr), node_id(0), is_active(false) {}
+	friend class BlockPartition;
 
-	Node(pointer value_ptr, size_type id_node, Block< value_type >* b) :
-		value_ptr(value_ptr), node_id(id_node), block(b), next(nullptr), prev(nullptr), is_active(true)
+	union
 	{
-	}
+		size_type node_id;
+		Node* next_free;
+	};
 
-	~Node()
-	{
-		next = nullptr;
-		prev = nullptr;
-		block = nullptr;
-		node_id = 0;
-		is_active = false;
-		delete value_ptr;
-	}
+	Node() : node_id(0) {}
 };
 
-template< typename T >
+template< typename T, std::size_t N >
 class Block
 {
   private:
 	using value_type = T;
 	using size_type = std::size_t;
+	using pointer = T*;
 
-	template< typename >
+	template< typename, std::size_t >
 	friend class ConstIterator;
 
-	template< typename >
+	template< typename, std::size_t >
 	friend class Iterator;
 
-	template< typename >
+	template< typename, typename, std::size_t, std::size_t >
 	friend class BucketStorage;
 
 	template< typename >
-	friend class MyStack;
+	friend class BlockPartition;
+
+	template< typename, std::size_t >
+	friend class BlockIndex;
+
+	template< typename, typename, std::size_t >
+	friend class BlockTable;
+
+	template< typename, typename, std::size_t >
+	friend class HoleIndex;
+
+	template< bool, typename, std::size_t >
+	friend class BlockView;
+
+	template< bool, typename, std::size_t >
+	friend class BlockIterator;
+
+	using mask_type = std::uint64_t;
 
-	Node< value_type >* b_head;
-	Node< value_type >* b_tail;
+	static constexpr size_type mask_bits = 64;
+	static constexpr size_type storage_alignment =
+		alignof(value_type) > alignof(Node< value_type >) ? alignof(value_type) : alignof(Node< value_type >);
+
+	static constexpr size_type mask_words(size_type capacity) { return (capacity + mask_bits - 1) / mask_bits; }
+
+	static constexpr bool fixed = N != 0;
+	static constexpr size_type fixed_words = mask_words(N);
+
+	static constexpr size_type extent(size_type capacity) { return fixed ? N : capacity; }
+
+	static constexpr size_type nodes_offset(size_type capacity)
+	{
+		return (mask_words(capacity) * sizeof(mask_type) + alignof(Node< value_type >) - 1) /
+			   alignof(Node< value_type >) * alignof(Node< value_type >);
+	}
+
+	static constexpr size_type slots_offset(size_type capacity)
+	{
+		return (nodes_offset(capacity) + capacity * sizeof(Node< value_type >) + alignof(value_type) - 1) /
+			   alignof(value_type) * alignof(value_type);
+	}
+
+	struct alignas(storage_alignment) chunk_type
+	{
+		unsigned char bytes[storage_alignment];
+	};
+
+	static constexpr size_type storage_chunks(size_type capacity)
+	{
+		return (slots_offset(capacity) + capacity * sizeof(value_type) + sizeof(chunk_type) - 1) / sizeof(chunk_type);
+	}
+
+	chunk_type* storage;
+	mask_type* occupancy;
+	Node< value_type >* nodes;
+	pointer slots;
 	Block* next;
 	Block* prev;
+	BlockIndex< value_type, N >* index;
+	Node< value_type >* free_head;
+	Block* hole_prev;
+	Block* hole_next;
+	size_type hole_slot;
+	size_type block_capacity;
+	size_type block_used;
 	size_type block_size;
 	size_type block_id;
+	size_type ordinal;
 	bool is_active;
 
-	explicit Block(size_type id_block) : block_id(id_block), next(nullptr), prev(nullptr)
+	Block(size_type id_block, size_type capacity, chunk_type* buffer) :
+		storage(buffer), occupancy(nullptr), nodes(nullptr), slots(nullptr), next(nullptr), prev(nullptr),
+		index(nullptr), free_head(nullptr), hole_prev(nullptr), hole_next(nullptr), hole_slot(0),
+		block_capacity(capacity), block_used(0), block_size(0), block_id(id_block), ordinal(0),
+		is_active(true)
 	{
-		b_head = nullptr;
-		b_tail = nullptr;
-		is_active = true;
-		block_size = 0;
+		auto* bytes = reinterpret_cast< unsigned char* >(storage);
+		occupancy = reinterpret_cast< mask_type* >(bytes);
+		nodes = reinterpret_cast< Node< value_type >* >(bytes + nodes_offset(extent(capacity)));
+		slots = reinterpret_cast< pointer >(bytes + slots_offset(extent(capacity)));
+		std::fill_n(occupancy, mask_words(extent(capacity)), mask_type(0));
+		for (size_type i = 0; i < extent(capacity); i++)
+		{
+			::new (static_cast< void* >(nodes + i)) Node< value_type >();
+		}
+	}
+
+	Block(size_type id_block, size_type capacity, chunk_type* buffer, size_type used, size_type size) :
+		storage(buffer), occupancy(nullptr), nodes(nullptr), slots(nullptr), next(nullptr), prev(nullptr),
+		index(nullptr), free_head(nullptr), hole_prev(nullptr), hole_next(nullptr), hole_slot(0),
+		block_capacity(capacity), block_used(used), block_size(size), block_id(id_block), ordinal(0),
+		is_active(true)
+	{
+		auto* bytes = reinterpret_cast< unsigned char* >(storage);
+		occupancy = reinterpret_cast< mask_type* >(bytes);
+		nodes = reinterpret_cast< Node< value_type >* >(bytes + nodes_offset(extent(capacity)));
+		slots = reinterpret_cast< pointer >(bytes + slots_offset(extent(capacity)));
 	}
 
 	Block() :
-		is_active(false), next(nullptr), prev(nullptr), block_id(0), block_size(0), b_head(nullptr), b_tail(nullptr)
+		storage(nullptr), occupancy(nullptr), nodes(nullptr), slots(nullptr), next(nullptr), prev(nullptr),
+		index(nullptr), free_head(nullptr), hole_prev(nullptr), hole_next(nullptr), hole_slot(0), block_capacity(0),
+		block_used(0), block_size(0), block_id(0), ordinal(0), is_active(false)
 	{
 	}
 
@@ -103,15 +182,160 @@ class Block
 	{
 		next = nullptr;
 		prev = nullptr;
-		block_size = 0;
 		block_id = 0;
 		is_active = false;
-		while (b_head)
+	}
+
+	size_type used_words() const
+	{
+		if constexpr (fixed)
+		{
+			return fixed_words;
+		}
+		else
+		{
+			return mask_words(block_used);
+		}
+	}
+
+	template< typename Allocator >
+	void destroy_values(Allocator& alloc) noexcept
+	{
+		if constexpr (std::is_trivially_destructible_v< value_type > &&
+					  !requires(Allocator& a, pointer p) { a.destroy(p); })
+		{
+			std::fill_n(occupancy, used_words(), mask_type(0));
+		}
+		else
+		{
+			for (size_type word = 0; word < used_words(); word++)
+			{
+				for (mask_type bits = occupancy[word]; bits != 0; bits &= bits - 1)
+				{
+					std::allocator_traits< Allocator >::destroy(alloc,
+																slots + word * mask_bits + std::countr_zero(bits));
+				}
+				occupancy[word] = 0;
+			}
+		}
+		block_used = 0;
+		block_size = 0;
+	}
+
+	pointer value_of(const Node< value_type >* node) const { return slots + (node - nodes); }
+
+	bool is_occupied(const Node< value_type >* node) const
+	{
+		size_type slot = node - nodes;
+		return (occupancy[slot / mask_bits] >> (slot % mask_bits)) & 1;
+	}
+
+	void set_occupied(const Node< value_type >* node, bool value)
+	{
+		size_type slot = node - nodes;
+		if (value)
+		{
+			occupancy[slot / mask_bits] |= mask_type(1) << (slot % mask_bits);
+		}
+		else
+		{
+			occupancy[slot / mask_bits] &= ~(mask_type(1) << (slot % mask_bits));
+		}
+	}
+
+	Node< value_type >* find_set(size_type from, bool occupied) const
+	{
+		if (from >= block_used)
+		{
+			return nullptr;
+		}
+		size_type words = used_words();
+		size_type word = from / mask_bits;
+		mask_type bits = (occupied ? occupancy[word] : ~occupancy[word]) & (~mask_type(0) << (from % mask_bits));
+		while (bits == 0)
+		{
+			if (++word == words)
+			{
+				return nullptr;
+			}
+			bits = occupied ? occupancy[word] : ~occupancy[word];
+		}
+		size_type slot = word * mask_bits + std::countr_zero(bits);
+		return slot < block_used ? nodes + slot : nullptr;
+	}
+
+	Node< value_type >* first_free() const { return find_set(0, false); }
+
+	Node< value_type >* first_active() const { return find_set(0, true); }
+
+	Node< value_type >* next_active(const Node< value_type >* node) const { return find_set(node - nodes + 1, true); }
+
+	Node< value_type >* last_active() const { return block_used ? prev_active(nodes + block_used) : nullptr; }
+
+	Node< value_type >* prev_active(const Node< value_type >* node) const
+	{
+		size_type slot = node - nodes;
+		if (slot == 0)
+		{
+			return nullptr;
+		}
+		if constexpr (fixed_words == 1)
+		{
+			mask_type bits = occupancy[0] & (~mask_type(0) >> (mask_bits - slot));
+			return bits ? nodes + (mask_bits - 1 - std::countl_zero(bits)) : nullptr;
+		}
+		size_type word = --slot / mask_bits;
+		mask_type bits = occupancy[word] & (~mask_type(0) >> (mask_bits - 1 - slot % mask_bits));
+		while (bits == 0)
+		{
+			if (word-- == 0)
+			{
+				return nullptr;
+			}
+			bits = occupancy[word];
+		}
+		return nodes + word * mask_bits + (mask_bits - 1 - std::countl_zero(bits));
+	}
+
+	size_type rank_of(const Node< value_type >* node) const
+	{
+		size_type slot = node - nodes;
+		if constexpr (fixed_words == 1)
+		{
+			return std::popcount(occupancy[0] & ((mask_type(1) << slot) - 1));
+		}
+		size_type rank = 0;
+		for (size_type word = 0; word < slot / mask_bits; word++)
+		{
+			rank += std::popcount(occupancy[word]);
+		}
+		mask_type below = (mask_type(1) << (slot % mask_bits)) - 1;
+		return rank + std::popcount(occupancy[slot / mask_bits] & below);
+	}
+
+	Node< value_type >* select(size_type rank) const
+	{
+		if constexpr (fixed_words == 1)
+		{
+			mask_type bits = occupancy[0];
+			for (; rank != 0; rank--)
+			{
+				bits &= bits - 1;
+			}
+			return nodes + std::countr_zero(bits);
+		}
+		size_type word = 0;
+		for (size_type count = std::popcount(occupancy[word]); rank >= count; count = std::popcount(occupancy[word]))
+		{
+			rank -= count;
+			word++;
+		}
+		mask_type bits = occupancy[word];
+		for (; rank != 0; rank--)
 		{
-			Node< value_type >* next_node = b_head->next;
-			delete b_head;
-			b_head = next_node;
+			bits &= bits - 1;
 		}
+		return nodes + word * mask_bits + std::countr_zero(bits);
 	}
 };
 
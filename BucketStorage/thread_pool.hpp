@@ -0,0 +1,170 @@
+#ifndef CT_C24_LW_CONTAINERS_NUDA9A_THREAD_POOL_HPP
+#define CT_C24_LW_CONTAINERS_NUDA9A_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class ThreadPool
+{
+  public:
+	using size_type = std::size_t;
+
+	explicit ThreadPool(size_type threads = std::thread::hardware_concurrency());
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+	~ThreadPool();
+
+	[[nodiscard]] size_type size() const noexcept { return workers.size() + 1; }
+
+	template< typename F >
+	void run(size_type tasks, F&& f);
+
+	static ThreadPool& shared();
+
+  private:
+	struct Job
+	{
+		std::function< void(size_type) > task;
+		size_type count;
+		std::atomic< size_type > next;
+		size_type active;
+		std::exception_ptr error;
+		std::mutex error_lock;
+	};
+
+	std::vector< std::thread > workers;
+	std::mutex lock;
+	std::mutex run_lock;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	Job* current;
+	size_type generation;
+	bool stopping;
+
+	static inline thread_local const ThreadPool* running = nullptr;
+
+	void work();
+	static void execute(Job& job);
+};
+
+inline ThreadPool::ThreadPool(size_type threads) : current(nullptr), generation(0), stopping(false)
+{
+	for (size_type i = 1; i < threads; i++)
+	{
+		workers.emplace_back([this] { work(); });
+	}
+}
+
+inline ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard< std::mutex > guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+inline ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+template< typename F >
+void ThreadPool::run(size_type tasks, F&& f)
+{
+	if (tasks == 0)
+	{
+		return;
+	}
+
+	Job job{ std::function< void(size_type) >(std::forward< F >(f)), tasks, 0, 0, nullptr, {} };
+	if (running == this)
+	{
+		execute(job);
+	}
+	else
+	{
+		std::lock_guard< std::mutex > run_guard(run_lock);
+		{
+			std::lock_guard< std::mutex > guard(lock);
+			current = &job;
+			generation++;
+		}
+		wake.notify_all();
+
+		const ThreadPool* outer = std::exchange(running, this);
+		execute(job);
+		running = outer;
+
+		std::unique_lock< std::mutex > guard(lock);
+		finished.wait(guard, [&job] { return job.active == 0; });
+		current = nullptr;
+	}
+	if (job.error)
+	{
+		std::rethrow_exception(job.error);
+	}
+}
+
+inline void ThreadPool::work()
+{
+	size_type seen = 0;
+	running = this;
+	std::unique_lock< std::mutex > guard(lock);
+	while (true)
+	{
+		wake.wait(guard, [this, &seen] { return stopping || generation != seen; });
+		if (stopping)
+		{
+			return;
+		}
+		seen = generation;
+		Job* job = current;
+		if (!job)
+		{
+			continue;
+		}
+		job->active++;
+		guard.unlock();
+
+		execute(*job);
+
+		guard.lock();
+		if (--job->active == 0)
+		{
+			finished.notify_all();
+		}
+	}
+}
+
+inline void ThreadPool::execute(Job& job)
+{
+	for (size_type i = job.next++; i < job.count; i = job.next++)
+	{
+		try
+		{
+			job.task(i);
+		} catch (...)
+		{
+			std::lock_guard< std::mutex > guard(job.error_lock);
+			if (!job.error)
+			{
+				job.error = std::current_exception();
+			}
+		}
+	}
+}
+
+#endif	  // CT_C24_LW_CONTAINERS_NUDA9A_THREAD_POOL_HPP